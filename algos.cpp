@@ -4,7 +4,10 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <numeric>
+#include <random>
 #include <string.h>
+#include <vector>
 
 #ifdef __AVX__
 #include <immintrin.h>
@@ -50,10 +53,10 @@ void avx_fill_alt(buf_elem* buf, size_t size, buf_elem val0, buf_elem val1) {
     size_t chunks = (size * sizeof(buf_elem) + 31) / 32;
     // we may overwrite by up to 127 bytes (one full iteration of writes - 1)
     for (size_t c = 0; c < chunks; c += 4) {
-        _mm256_store_si256(vbuf + c + 0, filler0);
-        _mm256_store_si256(vbuf + c + 1, filler0);
-        _mm256_store_si256(vbuf + c + 2, filler1);
-        _mm256_store_si256(vbuf + c + 3, filler1);
+        _mm256_storeu_si256(vbuf + c + 0, filler0);
+        _mm256_storeu_si256(vbuf + c + 1, filler0);
+        _mm256_storeu_si256(vbuf + c + 2, filler1);
+        _mm256_storeu_si256(vbuf + c + 3, filler1);
     }
     opt_control::sink_ptr(vbuf);
 #else
@@ -186,10 +189,10 @@ void avx_fill128(buf_elem* buf, size_t size, buf_elem val) {
     __m128i vecval = _mm_set1_epi32(val);
     size_t chunks = (size * sizeof(buf_elem) + 15) / 16;
     for (size_t c = 0; c < chunks; c += 4) {
-        _mm_store_si128(vbuf + c + 0, vecval);
-        _mm_store_si128(vbuf + c + 1, vecval);
-        _mm_store_si128(vbuf + c + 2, vecval);
-        _mm_store_si128(vbuf + c + 3, vecval);
+        _mm_storeu_si128(vbuf + c + 0, vecval);
+        _mm_storeu_si128(vbuf + c + 1, vecval);
+        _mm_storeu_si128(vbuf + c + 2, vecval);
+        _mm_storeu_si128(vbuf + c + 3, vecval);
     }
 }
 
@@ -200,8 +203,8 @@ void avx_fill256(buf_elem* buf, size_t size, buf_elem val) {
     __m256i vecval = _mm256_set1_epi32(val);
     size_t chunks = (size * sizeof(buf_elem) + 31) / 32;
     for (size_t c = 0; c < chunks; c += 2) {
-        _mm256_store_si256(vbuf + c + 0, vecval);
-        _mm256_store_si256(vbuf + c + 1, vecval);
+        _mm256_storeu_si256(vbuf + c + 0, vecval);
+        _mm256_storeu_si256(vbuf + c + 1, vecval);
     }
 }
 
@@ -215,9 +218,129 @@ void avx_fill512(buf_elem* buf, size_t size, buf_elem val) {
     __m512i vecval = _mm512_set1_epi32(val);
     size_t chunks = (size * sizeof(buf_elem) + 63) / 64;
     for (size_t c = 0; c < chunks; c++) {
-        _mm512_store_si512(vbuf + c, vecval);
+        _mm512_storeu_si512(vbuf + c, vecval);
     }
 }
 
 DELEGATE_01(fill512_, avx_fill512);
-#endif
\ No newline at end of file
+#endif
+
+static size_t scatter_bytes = 64;
+static scatter_pattern scatter_pat = scatter_pattern::RANDOM;
+// byte offsets from the start of the buffer of each object to zero
+static std::vector<int64_t> scatter_offsets;
+
+void scatter_configure(size_t obj_bytes, scatter_pattern pattern) {
+    assert(obj_bytes % 16 == 0);
+    scatter_bytes = obj_bytes;
+    scatter_pat = pattern;
+}
+
+size_t scatter_obj_bytes() {
+    return scatter_bytes;
+}
+
+/**
+ * The buffer is carved into object-sized slots and half of them are treated
+ * as freed objects to clear. The SLAB pattern takes every other slot in order,
+ * the RANDOM pattern takes the same number of slots at random, in random order.
+ */
+size_t scatter_prepare(buf_elem*, size_t size) {
+    size_t slots = size * sizeof(buf_elem) / scatter_bytes;
+    size_t count = (slots + 1) / 2;
+    scatter_offsets.clear();
+    scatter_offsets.reserve(count);
+    if (scatter_pat == scatter_pattern::SLAB) {
+        for (size_t s = 0; s < slots; s += 2) {
+            scatter_offsets.push_back(s * scatter_bytes);
+        }
+    } else {
+        std::vector<int64_t> all(slots);
+        std::iota(all.begin(), all.end(), 0);
+        std::mt19937_64 rng{slots}; // fixed seed, so every algo sees the same list
+        std::shuffle(all.begin(), all.end(), rng);
+        for (size_t i = 0; i < count; i++) {
+            scatter_offsets.push_back(all[i] * scatter_bytes);
+        }
+    }
+    assert(scatter_offsets.size() == count);
+    return count;
+}
+
+HEDLEY_NEVER_INLINE
+void scatter_scalar(buf_elem* buf, size_t) {
+    char* base = (char*)buf;
+    const size_t words = scatter_bytes / sizeof(uint64_t);
+    for (auto off : scatter_offsets) {
+        auto obj = (uint64_t *)(base + off);
+        for (size_t w = 0; w < words; w++) {
+            obj[w] = 0;
+            opt_control::sink_ptr(obj); // keep it scalar: no vectorization or memset call
+        }
+    }
+}
+
+HEDLEY_NEVER_INLINE
+void scatter_avx2(buf_elem* buf, size_t) {
+#ifdef __AVX2__
+    char* base = (char*)buf;
+    const size_t bytes = scatter_bytes;
+    __m256i zero = _mm256_setzero_si256();
+    for (auto off : scatter_offsets) {
+        char* obj = base + off;
+        size_t b = 0;
+        for (; b + 32 <= bytes; b += 32) {
+            _mm256_storeu_si256((__m256i *)(obj + b), zero);
+        }
+        if (b < bytes) {
+            // objects are a multiple of 16 bytes, so at most one 16-byte store remains
+            _mm_storeu_si128((__m128i *)(obj + b), _mm_setzero_si128());
+        }
+    }
+    opt_control::sink_ptr(buf);
+#else
+    (void)buf;
+    assert(false);
+#endif
+}
+
+/**
+ * Zeros 8 objects at a time with vpscatterqq, each scatter writing one
+ * qword to each of the 8 objects.
+ */
+HEDLEY_NEVER_INLINE
+void scatter_vpscatter(buf_elem* buf, size_t) {
+#ifdef __AVX512F__
+    const int64_t* offs = scatter_offsets.data();
+    const size_t count = scatter_offsets.size();
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i eight = _mm512_set1_epi64(8);
+    for (size_t i = 0; i < count; i += 8) {
+        __mmask8 m = count - i >= 8 ? 0xFF : (__mmask8)((1u << (count - i)) - 1);
+        __m512i idx = _mm512_maskz_loadu_epi64(m, offs + i);
+        for (size_t b = 0; b < scatter_bytes; b += 8) {
+            _mm512_mask_i64scatter_epi64(buf, m, idx, zero, 1);
+            idx = _mm512_add_epi64(idx, eight);
+        }
+    }
+    opt_control::sink_ptr(buf);
+#else
+    (void)buf;
+    assert(false);
+#endif
+}
+
+HEDLEY_NEVER_INLINE
+void scatter_stosb(buf_elem* buf, size_t) {
+    char* base = (char*)buf;
+    for (auto off : scatter_offsets) {
+#if defined(__x86_64__) || defined(__i386__)
+        void* dst = base + off;
+        size_t count = scatter_bytes;
+        asm volatile ("rep stosb" : "+D"(dst), "+c"(count) : "a"(0) : "memory");
+#else
+        memset(base + off, 0, scatter_bytes);
+#endif
+    }
+    opt_control::sink_ptr(buf);
+}
@@ -13,22 +13,36 @@
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cmath>
 #include <cinttypes>
 #include <cstdlib>
 #include <deque>
 #include <exception>
 #include <functional>
 #include <limits>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <numeric>
+#include <random>
 #include <set>
+#include <tuple>
 #include <thread>
 #include <vector>
 
 #include "args-wrap.hpp"
+#include "cache-info.hpp"
 #include "common.hpp"
+#include "cycle-timer.h"
 #include "fmt/format.h"
 #include "hedley.h"
+#include "histogram.hpp"
 #include "huge-alloc.h"
+#include "io-zero.hpp"
+#include "opt-control.hpp"
+#include "page-info.h"
+#include "phys-info.hpp"
+#include "precondition.hpp"
 #include "stamp.hpp"
 #include "stats.hpp"
 #include "table.hpp"
@@ -37,8 +51,10 @@
 #if USE_RDTSC
 #include "use-rdtsc.hpp"
 #define DefaultClock RdtscClock
+#define LatencyClock RdtscClock
 #else
-#define DefaultClock StdClock<std::chrono::high_resolution_clock>
+#define DefaultClock CycleTimerClock
+#define LatencyClock StdClock<std::chrono::steady_clock>
 #endif
 
 using namespace std::chrono;
@@ -52,6 +68,7 @@ struct test_func {
     const char* id;
     buf_elem intial; // fill the buffer with this initial value
     double work_factor = 1.;
+    prep_f* prepare = nullptr; // if non-null, called before the spec runs
 };
 
 std::vector<test_func> ALL_FUNCS = {
@@ -88,6 +105,16 @@ std::vector<test_func> ALL_FUNCS = {
 #ifdef __AVX512F__
     { fill512_0   , "fill512_0", 0      },
     { fill512_1   , "fill512_1", 1      },
+#endif
+    { scatter_scalar   , "scat_scalar", 0, 1., scatter_prepare },
+#ifdef __AVX2__
+    { scatter_avx2     , "scat_avx2"  , 0, 1., scatter_prepare },
+#endif
+#ifdef __AVX512F__
+    { scatter_vpscatter, "scat_vpsc"  , 0, 1., scatter_prepare },
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    { scatter_stosb    , "scat_stosb" , 0, 1., scatter_prepare },
 #endif
 };
 
@@ -111,22 +138,134 @@ static argsw::Flag arg_no_pin{parser, "no-pin",
 static argsw::Flag arg_verbose{parser, "verbose", "Output more info", {"verbose"}};
 static argsw::Flag arg_list{parser, "list", "List the available tests and their descriptions", {"list"}};
 static argsw::Flag arg_csv{parser, "", "Output a csv table instead of the default", {"csv"}};
+static argsw::Flag arg_stream{parser, "stream", "Write the results of each spec as soon as it finishes rather than all at the end: csv rows "
+    "under a single header, or table rows with the header repeated whenever a column widens", {"stream"}};
 
 static argsw::ValueFlag<std::string> arg_algos{parser, "ALGO1,ALGO2,...", "Run only the algorithms in the comma separated list", {"algos"}};
 static argsw::ValueFlag<std::string> arg_perfcols{parser, "COL1,COL2,...", "Include the additional perf-event based columns", {"perf-cols"}};
 static argsw::ValueFlag<std::string> arg_perfextra{parser, "EVENT1,EVENT2,...", "Include the additional arbitrary perf events", {"perf-extra"}};
 static argsw::ValueFlag<size_t> arg_target_size{parser, "SIZE", "Target size in bytes for each trial, used to calculate internal iters", {"trial-size"}, 100000};
+static argsw::ValueFlag<double> arg_trial_ms{parser, "MILLISECONDS", "Target duration of each trial: calibrates internal iters per spec, overriding --trial-size", {"trial-ms"}, 0.};
 static argsw::ValueFlag<size_t> arg_min_iters{parser, "ITERS", "Minimum number of internal iteratoins for each trial (default 2)", {"min-iters"}, 2};
-static argsw::ValueFlag<uint64_t> arg_warm_ms{parser, "MILLISECONDS", "Warmup milliseconds for each thread after pinning (default 100)", {"warmup-ms"}, 100};
+static argsw::ValueFlag<uint64_t> arg_warm_ms{parser, "MILLISECONDS", "Maximum warmup before each spec, which ends early once the CPU frequency settles (default 100, 0 disables)", {"warmup-ms"}, 100};
+static argsw::ValueFlag<double> arg_warm_tol{parser, "PERCENT", "The warmup ends once successive 1 ms CPU frequency samples agree to within this percent (default 1)", {"warmup-tol"}, 1.};
+static argsw::ValueFlag<size_t> arg_warmup_trials{parser, "TRIALS", "Untimed warmup trials run before the measured trials of each spec (default 10)", {"warmup-trials"}, 10};
+static argsw::ValueFlag<size_t> arg_min_trials{parser, "TRIALS", "Minimum number of measured trials for each spec (default 5)", {"min-trials"}, 5};
+static argsw::ValueFlag<size_t> arg_max_trials{parser, "TRIALS", "Maximum number of measured trials for each spec (default 100)", {"max-trials"}, 100};
+static argsw::ValueFlag<double> arg_target_ci{parser, "PERCENT", "Stop adding trials once the 95% CI of the median is within this percent (default 1)", {"target-ci"}, 1.};
+static argsw::ValueFlag<uint64_t> arg_max_spec_ms{parser, "MILLISECONDS", "Stop adding trials once a spec has run this long, after min-trials (default 1000)", {"max-spec-ms"}, 1000};
 
 static argsw::ValueFlag<size_t> arg_buf_min{parser, "KILOBYTES", "Minimum buffer size in bytes", {"min-size"}, 100};
 static argsw::ValueFlag<size_t> arg_buf_max{parser, "KILOBYTES", "Maximum buffer size in bytes", {"max-size"}, 100 * 1000 * 1000};
 static argsw::ValueFlag<size_t> arg_buf_sz {parser, "KILOBYTES", "Buffer size (overrides min and max)", {"size"}};
 static argsw::ValueFlag<double> arg_step   {parser, "RATIO", "Possibly factional ratio between successive sizes", {"step"}, 4. / 3.};
+static argsw::ValueFlag<size_t> arg_offset{parser, "BYTES", "Start the buffer this many bytes past its 2 MiB aligned allocation, "
+    "a multiple of 4 below 4096 (default 0)", {"offset"}, 0};
+static argsw::ValueFlag<size_t> arg_offset_sweep{parser, "STEP", "Run every spec at each buffer offset from 0 to 4095 in steps of STEP bytes, "
+    "a multiple of 4, adding an Offset column", {"offset-sweep"}};
+static argsw::ValueFlag<std::string> arg_pages{parser, "PAGES1,PAGES2,...", "Page backends to allocate the buffer with: 4k (THP disabled), thp, "
+    "hugetlb2m or hugetlb1g (which need pages reserved in nr_hugepages), memfd or file (a shared mapping of a file in --file-dir), "
+    "or cow (a private mapping of a zeroed memfd, for --buffer-state=cow). "
+    "Each spec runs on every backend, and a Pages column is added unless the only backend is thp (default thp)", {"pages"}, "thp"};
+static argsw::ValueFlag<std::string> arg_file_dir{parser, "DIR", "Directory for the --pages=file backing file, e.g., /dev/shm for tmpfs (default .)", {"file-dir"}, "."};
+static argsw::ValueFlag<std::string> arg_sync{parser, "SYNC", "After each trial on a memfd or file buffer (not cow), write it back with msync or fdatasync, "
+    "timed separately from the trial and reported in the Syncms and SyncGB/s columns: none, msync or fdatasync (default none)", {"sync"}, "none"};
+static argsw::Flag arg_backing_cols{parser, "backing-cols", "Add THP% and Node columns: the share of each spec's buffer backed by huge pages "
+    "and the NUMA nodes backing it, checked before its first trial", {"backing-cols"}};
+static argsw::ValueFlag<double> arg_huge_min{parser, "PERCENT", "Require this share of huge pages in the thp and hugetlb buffers: "
+    "THP buffers are collapsed (MADV_COLLAPSE) until they meet it, and specs whose part of the buffer falls short are flagged "
+    "with ! in THP%, implies --backing-cols (default 0: off)", {"huge-min"}, 0.};
+static argsw::ValueFlag<int> arg_collapse_retries{parser, "N", "Collapse attempts for --huge-min (default 3)", {"collapse-retries"}, 3};
+static argsw::Flag arg_huge_abort{parser, "huge-abort", "Exit rather than flag a spec that falls short of --huge-min", {"huge-abort"}};
+static argsw::ValueFlag<size_t> arg_page_info_threads{parser, "THREADS", "Threads used to read /proc/kpageflags when checking page backing (default 1)", {"page-info-threads"}, 1};
+static argsw::Flag arg_phys_report{parser, "phys-report", "Add the physical layout of each spec's buffer: the lowest physical address (PhysLo), "
+    "physically contiguous runs (Runs) and pages per NUMA node (NodePages), plus, with --channel-map, the share of lines on each DRAM channel (Chan%) "
+    "and the busiest channel's share over the mean (ChSkew). Chan% and ChSkew are predicted from the mapping only: the IMC counters "
+    "aren't read, so to compare with measured per-channel traffic, add the uncore IMC CAS count events with --perf-extra", {"phys-report"}};
+static argsw::ValueFlag<std::string> arg_channel_map{parser, "BITS", "The DRAM channel mapping for --phys-report: one XOR of physical address bits "
+    "per channel index bit, e.g., 6^13,7^14 for 4 channels", {"channel-map"}};
+static argsw::ValueFlag<std::string> arg_sweep{parser, "SWEEP", "Size sweep: geometric (every --step), adaptive (start at --step and add sizes where "
+    "--sweep-metric changes sharply between neighbouring sizes) or caches (every --step plus dense sizes around each cache level's capacity, "
+    "adding a Level column) (default geometric)", {"sweep"}, "geometric"};
+static argsw::ValueFlag<std::string> arg_sweep_metric{parser, "COLUMN", "The numeric column an adaptive sweep refines on, e.g., GB/s or a perf column (default GB/s)", {"sweep-metric"}, "GB/s"};
+static argsw::ValueFlag<double> arg_knee{parser, "PERCENT", "An adaptive sweep splits the interval between neighbouring sizes when the median metric of any algo differs by more than this (default 10)", {"knee"}, 10.};
+static argsw::ValueFlag<double> arg_sweep_res{parser, "PERCENT", "An adaptive sweep doesn't split sizes closer than this (default 2)", {"sweep-res"}, 2.};
+static argsw::ValueFlag<size_t> arg_sweep_budget{parser, "SIZES", "An adaptive sweep stops adding sizes once it has run this many (default 100)", {"sweep-budget"}, 100};
+
+static argsw::ValueFlag<std::string> arg_stats{parser, "STAT1,STAT2,...", "Add per-spec statistics columns for Nanos, GB/s and the perf columns: pNN, mean, stddev, mad, ci-lo, ci-hi, n", {"stats"}};
+static argsw::ValueFlag<double> arg_reject{parser, "K", "Reject samples more than K scaled MADs from the median when calculating --stats (default 0: off)", {"reject-outliers"}, 0.};
+
+#if USE_RDTSC
+static argsw::ValueFlag<std::string> arg_clock{parser, "CLOCK", "Clock used to time trials: rdtsc, rdtscp, rdpmc (core cycles), monotonic-raw, cycle-timer or chrono (default rdtsc). "
+    "Giving a clock adds a Cyc/CL column", {"clock"}, "rdtsc"};
+#else
+static argsw::ValueFlag<std::string> arg_clock{parser, "CLOCK", "Clock used to time trials: monotonic-raw, cycle-timer or chrono (default cycle-timer). "
+    "Giving a clock adds a Cyc/CL column", {"clock"}, "cycle-timer"};
+#endif
+static argsw::ValueFlag<std::string> arg_order{parser, "ORDER", "Order of execution: sequential runs each spec to completion, round-robin and random interleave trials of all specs (default sequential)", {"order"}, "sequential"};
+static argsw::ValueFlag<uint64_t> arg_seed{parser, "SEED", "Seed for --order=random (default 1)", {"seed"}, 1};
+
+static argsw::Flag arg_no_overhead{parser, "no-overhead-sub", "Don't subtract the measured timer, stamp and empty call overhead from the trial times and counters", {"no-overhead-sub"}};
+static argsw::Flag arg_overhead_col{parser, "overhead-col", "Add an Ovhd% column: the share of each raw trial time that was stamp and empty call overhead", {"overhead-col"}};
+
+static argsw::ValueFlag<double> arg_timeseries{parser, "SECONDS", "Instead of trials, fill continuously for SECONDS per spec, "
+    "sampling bandwidth and the perf columns every --ts-interval and writing the series as csv. The samples are raw: they include "
+    "the clock read after every call and the stamp per sample, which aren't subtracted", {"timeseries"}, 0.};
+static argsw::ValueFlag<uint64_t> arg_ts_interval{parser, "MICROSECONDS", "Sampling interval for --timeseries (default 100)", {"ts-interval"}, 100};
+
+static argsw::ValueFlag<std::string> arg_interrupts{parser, "MODE", "Detect trials disturbed by interrupts, context switches or CPU migrations: off, "
+    "flag (add an Intr column with their count) or rerun (also discard and rerun such trials, up to max-trials times per spec) (default off)",
+    {"interrupts"}, "off"};
+
+static argsw::Flag arg_io_zero{parser, "io-zero", "Instead of the algos, zero files of each size in the sweep with fallocate ZERO_RANGE "
+    "and PUNCH_HOLE, pwrite, vmsplice, splice from /dev/zero and copy_file_range, reporting GB/s and syscalls/GB over --min-trials trials", {"io-zero"}};
+static argsw::ValueFlag<std::string> arg_io_dirs{parser, "DIR1,DIR2,...", "Directories for the --io-zero files (default /dev/shm,.)", {"io-dirs"}, "/dev/shm,."};
+static argsw::ValueFlag<std::string> arg_io_methods{parser, "METHOD1,METHOD2,...", "The --io-zero methods to run: zero-range, punch-hole, pwrite, vmsplice, "
+    "splice or copy-range (default all)", {"io-methods"}};
+static argsw::ValueFlag<size_t> arg_io_chunk{parser, "BYTES", "Bytes moved by each pwrite, vmsplice or splice call in --io-zero (default 1048576)", {"io-chunk"}, 1u << 20};
+
+static argsw::Flag arg_latency{parser, "latency", "Time every call and report per-call latency percentiles (Lat50, Lat99, Lat99.9, LatMax)", {"latency"}};
+static argsw::ValueFlag<std::string> arg_hist_dump{parser, "FILE", "With --latency (which it requires), write the full per-call latency histogram of every spec to FILE as csv", {"hist-dump"}};
+
+static argsw::ValueFlag<std::string> arg_precondition{parser, "STATE", "Cache state of the buffer at the start of each trial, set up outside the timed region: "
+    "none, flush (cold), clean (flushed then read: resident and exclusive), dirty (overwritten with non-zero data) or shared (also read from another CPU) (default none)",
+    {"precondition"}, "none"};
+static argsw::ValueFlag<std::string> arg_buffer_state{parser, "STATE", "Page state of the buffer at the start of each trial, set up outside the timed region: "
+    "touched, zero-page (read but never written, so mapped to the shared zero page), untouched (unmapped with MADV_DONTNEED) or "
+    "ksm (zeroed and merged by KSM, which must be running) or cow (with --pages=cow, every page mapped read-only from the file, so the first "
+    "write copies it, as in a child after fork, adding Faults/MB and Copies/MB columns). Any state but touched adds State%, 1stGB/s and RestGB/s columns: "
+    "the share of pages found in the state and the bandwidth of the first call of each trial, which breaks the state, "
+    "and of the rest (default touched)", {"buffer-state"}, "touched"};
+static argsw::Flag arg_first_touch{parser, "first-touch", "Run every trial on freshly unmapped pages (--buffer-state=untouched) with one call per trial, "
+    "so the kernel faults in and zeroes every page the fill touches, adding Faults/MB, Kern% (the kernel's share of the time) and "
+    "ns/Fault columns. Use --pages to compare 4K and THP faults", {"first-touch"}};
+static argsw::ValueFlag<size_t> arg_ksm_wait{parser, "MILLISECONDS", "Longest wait for KSM to merge the buffer before each trial with --buffer-state=ksm (default 10000)", {"ksm-wait-ms"}, 10000};
+
+static argsw::ValueFlag<size_t> arg_obj_size{parser, "BYTES", "Object size for the scat_ algos, a multiple of 16 from 16 to 4096 (default 64)", {"obj-size"}, 64};
+static argsw::ValueFlag<std::string> arg_obj_pattern{parser, "random|slab", "Object placement for the scat_ algos (default random)", {"obj-pattern"}, "random"};
 
 static bool verbose; // true for verbose output
+static precondition pcond = precondition::NONE; // applied to the buffer before every trial
+static buffer_state bstate = STATE_TOUCHED;     // and the page state, set up after it
+static bool first_touch; // true for --first-touch: one call per trial on untouched pages
+static bool rerun_interrupted;  // true to rerun trials with interrupts, context switches or migrations
+static uint64_t clock_overhead_ns;   // subtracted from the benchmark clock time of each trial
+static double clock_overhead_cycles; // and from the cycles
+static double stamp_overhead_ns;     // the stamp overhead in nanos, set once it has been measured
+static double call_overhead_ns;      // subtracted for each call of the test function in a trial
+static double call_overhead_cycles;  // and from the cycles
+static double empty_call_ns;         // the cost of calling an empty test function, set once it has been measured
 static FILE* out;    // where non-data (informational) output should go
 
+static std::vector<size_t> buf_offsets{0}; // the offsets in bytes of the buffer start to run every spec at
+static std::vector<std::pair<page_backend, buf_elem*>> buffers; // the start of the allocation for each page backend
+static bool check_backing; // true to check the page backing of each spec's buffer
+static channel_map dram_map;  // the channel mapping for --phys-report, empty if not given
+static int sync_mode;         // 0 for no sync after each trial, 1 for msync, 2 for fdatasync
+
+struct column_base;
+static const column_base* sweep_metric; // the column an adaptive sweep refines on, or null for a fixed sweep
+
 
 template <typename CHRONO_CLOCK>
 struct StdClock {
@@ -145,6 +284,56 @@ struct StdClock {
     static uint64_t now_to_nanos(now_t tp) {
         return to_nanos(tp.time_since_epoch());
     }
+
+    /* estimated from the nanos using the frequency calibrated by cycle-timer */
+    static double to_cycles(delta_t d) {
+        return cl_to_cycles(cl_interval{(int64_t)to_nanos(d)});
+    }
+
+    static void init() {
+        cl_init(false);
+    }
+};
+
+/**
+ * The portable cycle-timer clock: CLOCK_MONOTONIC nanos, converted to cycles
+ * using the CPU frequency estimated by a calibration loop at startup.
+ */
+struct CycleTimerClock {
+    using now_t   = uint64_t;
+    using delta_t = uint64_t;
+
+    static now_t now() {
+        return cl_now().nanos;
+    }
+
+    static uint64_t to_nanos(delta_t d) {
+        return cl_to_nanos(cl_interval{(int64_t)d});
+    }
+
+    static uint64_t now_to_nanos(now_t n) {
+        return n;
+    }
+
+    static double to_cycles(delta_t d) {
+        return cl_to_cycles(cl_interval{(int64_t)d});
+    }
+
+    static void init() {
+        cl_init(false);
+    }
+};
+
+/**
+ * CLOCK_MONOTONIC_RAW, which isn't subject to NTP frequency adjustment, with cycles
+ * estimated as for CycleTimerClock.
+ */
+struct MonotonicRawClock : CycleTimerClock {
+    static now_t now() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
 };
 
 template <typename CLOCK = DefaultClock>
@@ -152,6 +341,21 @@ static uint64_t now_nanos() {
     return CLOCK::now_to_nanos(CLOCK::now());
 }
 
+/* convert a clock delta to raw ticks, and back to nanos, for storing deltas in a LogHistogram */
+static inline uint64_t delta_ticks(uint64_t delta) {
+    return delta;
+}
+
+template <typename R, typename P>
+static uint64_t delta_ticks(std::chrono::duration<R, P> delta) {
+    return delta.count();
+}
+
+template <typename CLOCK>
+static uint64_t ticks_to_nanos(uint64_t ticks) {
+    return CLOCK::to_nanos(typename CLOCK::delta_t(ticks));
+}
+
 /*
  * The result of the run_test method, with only the stuff
  * that can be calculated from within that method.
@@ -161,6 +365,14 @@ struct result {
     StampDelta delta;
     size_t iters;
     size_t bufsz;
+    uint64_t nanos; // elapsed time of the trial according to the benchmark clock
+    double cycles;  // and in cycles, as reported by the benchmark clock
+    uint64_t offset_nanos = 0; // for --timeseries samples, the start of the sample relative to the start of the series
+    uint64_t first_nanos = 0;  // with a --buffer-state, the time of the first call, which breaks the state
+    double state_ratio = -1;   // and the share of pages found in that state before the trial, if known
+    int64_t sync_nanos = -1;   // with --sync, the time to write back the buffer after the trial, -1 if not synced
+    double cow_copies = -1;    // with --buffer-state=cow, the pages copied by the trial, -1 if unknown
+    double raw_nanos = 0;      // the stamp delta time before any overhead is subtracted
 
     size_t buf_bytes() const {
         return bufsz * sizeof(buf_elem);
@@ -172,24 +384,45 @@ struct test_spec {
     size_t iters;
     int* buf;
     size_t bufsz;
+    size_t offset; // bytes between the start of the allocation and buf
+    page_backend pages; // the page backend of the allocation
 };
 
 struct result_holder {
     test_spec spec;
+    uint64_t serial; // unique to each run of a spec, and kept by copies, unlike the address
     size_t iters;
+    size_t objects = 0;   // objects touched per call, for object based algos (those with a prepare function)
+    size_t obj_bytes = 0; // size of each of those objects
 
     /** results */
     DescriptiveStats elapsedns_stats;
+    double median_ci = 0; // relative half-width of the CI of the median trial time
     uint64_t timed_iters = 0; // the number of iterationreac the ctimed part of the test
     uint64_t total_iters = 0;
+    size_t reruns = 0; // trials thrown away and run again because they were interrupted
+    double huge_ratio = -1;       // share of the buffer backed by huge pages, if checked and known
+    unsigned long long nodes = 0; // mask of the NUMA nodes backing the buffer, if checked and known
+    bool huge_short = false;      // true if huge_ratio fell short of --huge-min
+    phys_layout phys;             // the physical layout of the buffer, with --phys-report
+    bool phys_checked = false;    // true once phys has been filled in
 
     std::vector<result> results;  // the results from each non-warmup trial
 
+    // per-call latencies in LatencyClock ticks for the measured trials, only with --latency
+    std::shared_ptr<LogHistogram> latencies;
+
     result_holder(test_spec spec, size_t iters) :
             spec{std::move(spec)},
+            serial{next_serial()},
             iters{iters}
             {}
 
+    static uint64_t next_serial() {
+        static uint64_t last;
+        return ++last;
+    }
+
     template <typename E>
     double inner_sum(E e) const {
         double a = 0;
@@ -205,69 +438,564 @@ struct result_holder {
     double inner_sum(result_holder::ir_u64 pmem) const {
         return inner_sum(std::mem_fn(pmem));
     }
+
+    /** the number of bytes written by each call of the test function */
+    double call_bytes() const {
+        if (spec.func.prepare) {
+            return (double)objects * obj_bytes;
+        }
+        return spec.func.work_factor * spec.bufsz * sizeof(buf_elem);
+    }
 };
 
+class result_stream;
+static result_stream* stream; // with --stream, where each spec's results are written as it finishes
+static void spec_finished(const result_holder& holder);
+
+/**
+ * Warms up the core until its frequency has settled, rather than for a fixed time: the
+ * core clock is sampled by timing a chain of dependent adds (one add per cycle), and the
+ * warmup ends once SETTLED consecutive samples agree to within tolerance, or after
+ * max_millis. If a spec finished within HOT_NANOS the core is already running at its
+ * steady frequency and the warmup is skipped entirely.
+ */
 struct warmup {
-    uint64_t millis;
-    warmup(uint64_t millis) : millis{millis} {}
+    static constexpr uint64_t SAMPLE_NANOS = 1000000; // length of each frequency sample
+    static constexpr uint64_t HOT_NANOS    = 10000000;
+    static constexpr int      SETTLED      = 3;
+
+    uint64_t max_millis;
+    double tolerance;
+    double ghz = 0;       // the last sampled core frequency
+    bool settled = false; // true if the warmup ended because the frequency settled
+
+    warmup(uint64_t max_millis, double tolerance) : max_millis{max_millis}, tolerance{tolerance} {}
 
+    /* mark the core as busy up until now, called after each spec */
+    static void mark_active() {
+        last_active() = now_nanos();
+    }
+
+    /* returns the number of frequency samples taken, or -1 if the warmup was skipped */
     long warm() {
-        auto end = now_nanos() + 1000000u * millis;
-        long iters = 0;
-        while (now_nanos() < end) {
-            iters++;
+        auto start = now_nanos();
+        if (max_millis == 0 || (last_active() && start - last_active() < HOT_NANOS)) {
+            return -1;
         }
-        return iters;
+        auto end = start + 1000000u * max_millis;
+        long samples = 0;
+        int stable = 0;
+        double prev = 0;
+        while (stable < SETTLED && now_nanos() < end) {
+            ghz = sample_ghz();
+            samples++;
+            stable = prev && std::abs(ghz / prev - 1) <= tolerance ? stable + 1 : 0;
+            prev = ghz;
+        }
+        settled = stable >= SETTLED;
+        mark_active();
+        return samples;
     }
-};
 
-template <typename CLOCK = DefaultClock, size_t MEASURED = 17, size_t WARMUP = 10>
-result_holder run_test(const test_spec& spec, const StampConfig& config) {
-    constexpr size_t TRIALS = WARMUP + MEASURED;
-    const auto iters = spec.iters;
+private:
+    static uint64_t& last_active() {
+        static uint64_t nanos;
+        return nanos;
+    }
 
-    warmup w{arg_warm_ms.Get()};
-    long warms = w.warm();
-    if (verbose) {
-        fmt::print(out, "Running: id={}, iters={}, bufsz={}, warms={}\n",
-                spec.func.id, spec.iters, spec.bufsz, warms);
+    /* the rate of dependent adds per nanosecond over about SAMPLE_NANOS, i.e., the core GHz */
+    static double sample_ghz() {
+        constexpr uint64_t CHUNK = 10000;
+        // add a register rather than an immediate: some cores eliminate chains of immediate adds at rename
+        uint64_t adds = 0, x = 0, one = 1;
+        opt_control::modify(one);
+        auto start = now_nanos(), now = start;
+        do {
+            for (uint64_t i = 0; i < CHUNK; i++) {
+                x += one;
+                opt_control::modify(x);
+            }
+            adds += CHUNK;
+            now = now_nanos();
+        } while (now - start < SAMPLE_NANOS);
+        opt_control::sink(x);
+        return (double)adds / (now - start);
     }
+};
 
-    // set the buffer to the specified fill value
+/* set the buffer to the state the spec expects before its first trial, and check its backing */
+/* fill the buffer with the initial value and prepare the spec: all a trial needs after another spec ran */
+static void refill_buffer(const test_spec& spec, result_holder& rh) {
     std::fill(spec.buf, spec.buf + spec.bufsz, spec.func.intial);
+    if (spec.func.prepare) {
+        rh.objects = spec.func.prepare(spec.buf, spec.bufsz);
+        rh.obj_bytes = scatter_obj_bytes();
+    }
+}
 
-    std::array<typename CLOCK::delta_t, TRIALS> trial_timings;
-    std::array<Stamp, TRIALS> trial_stamps;
+static void init_buffer(const test_spec& spec, result_holder& rh) {
+    refill_buffer(spec, rh);
+    if (check_backing) {
+        auto bytes = spec.bufsz * sizeof(buf_elem);
+        rh.huge_ratio = page_huge_ratio(spec.buf, bytes, spec.pages);
+        rh.nodes = page_node_mask(spec.buf, bytes);
+        double min = arg_huge_min.Get() / 100.;
+        bool huge = spec.pages == PAGES_THP || spec.pages == PAGES_HUGETLB_2M || spec.pages == PAGES_HUGETLB_1G;
+        if (huge && rh.huge_ratio >= 0 && rh.huge_ratio < min) {
+            rh.huge_short = true;
+            if (arg_huge_abort) {
+                fmt::print(stderr, "{} at size {} on {} pages is only {:.1f}% backed by huge pages, below --huge-min {}%\n",
+                        spec.func.id, bytes, page_backend_name(spec.pages), 100 * rh.huge_ratio, arg_huge_min.Get());
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    if (arg_phys_report && !rh.phys_checked) {
+        rh.phys = get_phys_layout(spec.buf, spec.bufsz * sizeof(buf_elem), dram_map);
+        rh.phys_checked = true;
+    }
+}
 
-    result_holder rh(spec, iters);
+/**
+ * Pick the number of calls per trial so that a trial takes about trial_ms: time batches
+ * of calls, doubling the batch size until a batch takes at least a quarter of the target,
+ * then scale the batch up to the target. The spec must already be prepared, since the
+ * scat_ algos time against the object list that prepare builds for this buffer.
+ */
+template <typename CLOCK>
+size_t calibrate_iters(const test_spec& spec, double trial_ms) {
+    const double target = trial_ms * 1000000.;
+    spec.func.func(spec.buf, spec.bufsz); // untimed, so the first batch isn't cold
+    for (size_t calls = 1; ; calls *= 2) {
+        auto t0 = CLOCK::now();
+        for (size_t i = 0; i < calls; i++) {
+            spec.func.func(spec.buf, spec.bufsz);
+        }
+        auto t1 = CLOCK::now();
+        double nanos = std::max(CLOCK::to_nanos(t1 - t0), (uint64_t)1);
+        if (nanos * 4 >= target || calls >= (1u << 30)) {
+            return std::max((size_t)std::ceil(target * calls / nanos), arg_min_iters.Get());
+        }
+    }
+}
+
+struct overhead {
+    static constexpr size_t CALLS = 100; // the empty calls timed per sample
+
+    uint64_t clock_nanos;
+    double clock_cycles;
+    StampDelta stamps;
+    double call_nanos, call_cycles; // per empty call
+    StampDelta calls;               // for CALLS empty calls, less the stamps
+};
 
-    for (size_t t = 0; t < TRIALS; t++) {
-        auto i = iters;
+// the empty test function, called through a volatile pointer as the real ones are called through test_func
+HEDLEY_NEVER_INLINE
+static void empty_func(buf_elem*, size_t) {}
+static cal_f* volatile empty_func_ptr = empty_func;
+
+/**
+ * Measure the overhead of an empty trial: a pair of stamps around a pair of CLOCK reads
+ * with nothing between them, and the cost of each call of a test function that does
+ * nothing, taking the minimum over many samples so that the overhead is never
+ * overestimated.
+ */
+template <typename CLOCK = DefaultClock>
+overhead measure_overhead(const StampConfig& config) {
+    constexpr int SAMPLES = 1000;
+    const double inf = std::numeric_limits<double>::infinity();
+    overhead o{(uint64_t)-1, inf, {}, inf, inf, {}};
+    for (int i = 0; i < SAMPLES; i++) {
+        auto before = config.stamp();
         auto t0 = CLOCK::now();
-        for (size_t i = 0; i < iters; i++) {
+        auto t1 = CLOCK::now();
+        auto after = config.stamp();
+        o.clock_nanos = std::min(o.clock_nanos, CLOCK::to_nanos(t1 - t0));
+        o.clock_cycles = std::min(o.clock_cycles, CLOCK::to_cycles(t1 - t0));
+        o.stamps = StampDelta::min(o.stamps, config.raw_delta(before, after));
+    }
+    for (int i = 0; i < SAMPLES; i++) {
+        auto before = config.stamp();
+        auto t0 = CLOCK::now();
+        for (size_t c = 0; c < overhead::CALLS; c++) {
+            empty_func_ptr(nullptr, 0);
+        }
+        auto t1 = CLOCK::now();
+        auto after = config.stamp();
+        o.call_nanos = std::min(o.call_nanos, (double)CLOCK::to_nanos(t1 - t0));
+        o.call_cycles = std::min(o.call_cycles, CLOCK::to_cycles(t1 - t0));
+        o.calls = StampDelta::min(o.calls, config.raw_delta(before, after));
+    }
+    o.call_nanos = std::max(o.call_nanos - o.clock_nanos, 0.) / overhead::CALLS;
+    o.call_cycles = std::max(o.call_cycles - o.clock_cycles, 0.) / overhead::CALLS;
+    o.calls = StampDelta::apply(o.calls, o.stamps, [](uint64_t l, uint64_t r) { return l > r ? l - r : 0; });
+    return o;
+}
+
+/**
+ * Runs the trials of a single spec: warmup-trials untimed trials, followed by measured
+ * trials which are added until the median trial time has converged to within target-ci,
+ * or until max-trials or max-spec-ms is hit (but always at least min-trials).
+ *
+ * Trials are run one at a time by run_trial, so the trials of several runners can be
+ * interleaved: in that case the caller asks run_trial to restore the buffer state the
+ * spec expects, since another spec has probably run in between.
+ */
+template <typename CLOCK = DefaultClock>
+class spec_runner {
+    const test_spec spec;
+    const StampConfig& config;
+    const size_t warmup_trials, min_trials, max_trials;
+    const double target_ci;
+    const uint64_t max_nanos;
+
+    result_holder rh;
+    LogHistogram* hist = nullptr;
+    // with --latency, the latencies of the current trial, only merged into hist if the trial is kept
+    std::unique_ptr<LogHistogram> trial_hist;
+    // the stamps before and after each trial and the measured trial times
+    std::vector<Stamp> before, after;
+    std::vector<uint64_t> nanos, first_nanos;
+    std::vector<int64_t> sync_nanos;
+    std::vector<double> cow_copies;
+    std::vector<double> cycles, state_ratios;
+    size_t trial = 0;
+    uint64_t spent = 0;
+    bool done_ = false;
+
+    void init_buffer() {
+        ::init_buffer(spec, rh);
+    }
+
+public:
+    spec_runner(const test_spec& spec, const StampConfig& config) :
+            spec{spec},
+            config{config},
+            warmup_trials{arg_warmup_trials.Get()},
+            min_trials{arg_min_trials.Get()},
+            max_trials{arg_max_trials.Get()},
+            target_ci{arg_target_ci.Get() / 100.},
+            max_nanos{arg_max_spec_ms.Get() * 1000000ull},
+            rh{spec, spec.iters}
+    {
+        init_buffer(); // prepares the spec, which calibrate_iters needs
+        if (first_touch) {
+            rh.iters = 1; // only the first call after the pages are dropped faults them in
+        } else if (arg_trial_ms.Get() > 0) {
+            rh.iters = calibrate_iters<CLOCK>(spec, arg_trial_ms.Get());
+        }
+        if (verbose) {
+            fmt::print(out, "Running: id={}, iters={}, bufsz={}\n", spec.func.id, rh.iters, spec.bufsz);
+        }
+        if (arg_latency) {
+            rh.latencies = std::make_shared<LogHistogram>();
+            hist = rh.latencies.get();
+            trial_hist.reset(new LogHistogram());
+        }
+        // the stamps are pushed inside the timed region, so reserve for every trial that can run:
+        // the warmup trials, max_trials measured trials and up to max_trials reruns
+        before.reserve(warmup_trials + 2 * max_trials);
+        after.reserve(warmup_trials + 2 * max_trials);
+        // these grow after the after stamp, so only the common case is reserved
+        nanos.reserve(min_trials);
+        cycles.reserve(min_trials);
+    }
+
+    bool done() const {
+        return done_;
+    }
+
+    /**
+     * Run one trial. If restore is true, the buffer is first returned to the state it would
+     * have if this spec had run the previous trial: it is refilled and the test function is
+     * called once, untimed. The backing checks aren't repeated, they ran when the runner
+     * was created.
+     */
+    void run_trial(bool restore) {
+        assert(!done_);
+        if (restore) {
+            refill_buffer(spec, rh);
+            spec.func.func(spec.buf, spec.bufsz);
+        }
+        precondition_apply(pcond, spec.buf, spec.bufsz * sizeof(buf_elem));
+        double state_ratio = -1;
+        if (bstate != STATE_TOUCHED) {
+            state_ratio = buffer_state_apply(spec.buf, spec.bufsz * sizeof(buf_elem), bstate, arg_ksm_wait.Get());
+        }
+
+        if (trial_hist) {
+            trial_hist->clear();
+        }
+
+        const size_t iters = rh.iters;
+        size_t i = 0;
+        // each trial has its own pair of stamps around just the calls, rather than sharing a stamp
+        // with the next trial, so the convergence check and other bookkeeping below aren't counted
+        before.push_back(config.stamp());
+        auto t0 = CLOCK::now(), tf = t0;
+        if (bstate != STATE_TOUCHED) {
+            // the first call breaks the buffer state, so it is timed on its own (and left out of any latency histogram)
             spec.func.func(spec.buf, spec.bufsz);
+            tf = CLOCK::now();
+            i++;
+        }
+        if (hist && trial >= warmup_trials) {
+            for (; i < iters; i++) {
+                auto c0 = LatencyClock::now();
+                spec.func.func(spec.buf, spec.bufsz);
+                trial_hist->record(delta_ticks(LatencyClock::now() - c0));
+            }
+        } else {
+            for (; i < iters; i++) {
+                spec.func.func(spec.buf, spec.bufsz);
+            }
         }
         auto t1 = CLOCK::now();
-        trial_stamps[t] = config.stamp();
-        trial_timings[t] = t1 - t0;
+        after.push_back(config.stamp());
+
+        double copies = -1;
+        if (bstate == STATE_COW && state_ratio >= 0) {
+            // every page that stopped being a file page was copied
+            auto bytes = spec.bufsz * sizeof(buf_elem);
+            auto pages = (((uintptr_t)spec.buf + bytes + 4095) / 4096) - (uintptr_t)spec.buf / 4096;
+            copies = (state_ratio - buffer_state_ratio(spec.buf, bytes, bstate)) * pages;
+        }
+
+        int64_t synced = -1;
+        if (sync_mode) {
+            auto s0 = CLOCK::now();
+            if (page_sync(spec.buf, spec.bufsz * sizeof(buf_elem), sync_mode == 2) == 0) {
+                synced = CLOCK::to_nanos(CLOCK::now() - s0);
+            }
+        }
+
+        auto raw_nanos = CLOCK::to_nanos(t1 - t0);
+        auto trial_overhead = clock_overhead_ns + iters * call_overhead_ns;
+        uint64_t trial_nanos = raw_nanos > trial_overhead ? raw_nanos - trial_overhead : 0;
+        spent += trial_nanos;
+        if (trial >= warmup_trials && rerun_interrupted && rh.reruns < max_trials
+                && config.delta(before.back(), after.back()).contaminated()) {
+            // throw the trial away, the next call runs it again
+            before.pop_back();
+            after.pop_back();
+            rh.reruns++;
+            return;
+        }
+        if (trial++ < warmup_trials) {
+            return;
+        }
+        if (hist) {
+            hist->merge(*trial_hist);
+        }
+        nanos.push_back(trial_nanos);
+        cycles.push_back(std::max(CLOCK::to_cycles(t1 - t0) - clock_overhead_cycles - iters * call_overhead_cycles, 0.));
+        auto first = CLOCK::to_nanos(tf - t0);
+        first_nanos.push_back(first > clock_overhead_ns + call_overhead_ns ? first - clock_overhead_ns - call_overhead_ns : 0);
+        state_ratios.push_back(state_ratio);
+        sync_nanos.push_back(synced);
+        cow_copies.push_back(copies);
+        if (nanos.size() >= max_trials) {
+            done_ = true;
+        } else if (nanos.size() >= min_trials &&
+                (spent >= max_nanos || Stats::median_ci(nanos.begin(), nanos.end()) <= target_ci)) {
+            done_ = true;
+        }
     }
 
-    rh.timed_iters = MEASURED * iters;
-    rh.total_iters = TRIALS * iters;
+    /* collect the results, call only once done() is true */
+    result_holder finish() {
+        assert(done_);
+        const size_t measured = nanos.size();
+        rh.timed_iters = measured * rh.iters;
+        rh.total_iters = trial * rh.iters;
+
+        rh.elapsedns_stats = get_stats(nanos.begin(), nanos.end());
+        rh.median_ci = Stats::median_ci(nanos.begin(), nanos.end());
+
+        rh.results.reserve(measured);
+        for (size_t t = warmup_trials; t < trial; t++) {
+            auto sd = config.delta(before.at(t), after.at(t), rh.iters);
+            size_t m = t - warmup_trials;
+            result r{m, sd, rh.iters, spec.bufsz, nanos.at(m), cycles.at(m), 0, first_nanos.at(m), state_ratios.at(m), sync_nanos.at(m), cow_copies.at(m)};
+            r.raw_nanos = config.raw_delta(before.at(t), after.at(t)).get_nanos();
+            rh.results.push_back(r);
+        }
+        assert(rh.results.size() == measured);
 
-    std::array<uint64_t, MEASURED> nanos = {};
-    std::transform(trial_timings.begin() + WARMUP, trial_timings.end(), nanos.begin(), CLOCK::to_nanos);
-    rh.elapsedns_stats = get_stats(nanos.begin(), nanos.end());
+        if (verbose) {
+            fmt::print(out, "Finished: id={}, bufsz={}, trials={}, median CI={:.2f}%\n",
+                    spec.func.id, spec.bufsz, measured, 100 * rh.median_ci);
+        }
 
-    rh.results.reserve(MEASURED);
-    assert(WARMUP > 0);
-    for (size_t t = WARMUP; t < TRIALS; t++) {
-        auto sd = config.delta(trial_stamps.at(t - 1), trial_stamps.at(t));
-        result r{t - WARMUP, sd, iters, spec.bufsz};
-        rh.results.push_back(r);
+        return rh;
     }
-    assert(rh.results.size() == MEASURED);
+};
 
+/**
+ * Runs the given spec to completion.
+ */
+template <typename CLOCK = DefaultClock>
+result_holder run_test(const test_spec& spec, const StampConfig& config) {
+    warmup w{arg_warm_ms.Get(), arg_warm_tol.Get() / 100.};
+    long samples = w.warm();
+    if (verbose) {
+        if (samples < 0) {
+            fmt::print(out, "Warmup skipped: id={}, bufsz={}\n", spec.func.id, spec.bufsz);
+        } else {
+            fmt::print(out, "Warmed up: id={}, bufsz={}, samples={}, GHz={:.2f}{}\n", spec.func.id, spec.bufsz,
+                    samples, w.ghz, w.settled ? "" : " (not settled)");
+        }
+    }
+
+    spec_runner<CLOCK> runner{spec, config};
+    while (!runner.done()) {
+        runner.run_trial(false);
+    }
+    warmup::mark_active();
+    auto rh = runner.finish();
+    spec_finished(rh);
+    return rh;
+}
+
+/**
+ * Runs all the specs with their trials interleaved, so that slow drift in the machine
+ * state affects every spec equally rather than whichever specs happen to run last. If
+ * random is false, each pass over the unfinished specs runs one trial of each spec in
+ * order, otherwise each trial is from a spec picked at random using the given seed.
+ *
+ * The results are returned in the same order as specs.
+ */
+template <typename CLOCK = DefaultClock>
+std::vector<result_holder> run_interleaved(const std::vector<test_spec>& specs, const StampConfig& config,
+        bool random, uint64_t seed) {
+    warmup{arg_warm_ms.Get(), arg_warm_tol.Get() / 100.}.warm();
+
+    std::vector<spec_runner<CLOCK>> runners;
+    runners.reserve(specs.size());
+    for (auto& spec : specs) {
+        runners.emplace_back(spec, config);
+    }
+
+    std::vector<size_t> pending(specs.size());
+    std::iota(pending.begin(), pending.end(), 0);
+    std::mt19937_64 rng{seed};
+    size_t next = 0;
+    std::map<size_t, result_holder> finished; // by index in specs
+    while (!pending.empty()) {
+        size_t pos = random ? std::uniform_int_distribution<size_t>{0, pending.size() - 1}(rng) : next % pending.size();
+        auto& runner = runners.at(pending[pos]);
+        runner.run_trial(true);
+        if (runner.done()) {
+            auto it = finished.emplace(pending[pos], runner.finish()).first;
+            spec_finished(it->second);
+            pending.erase(pending.begin() + pos);
+        } else {
+            pos++;
+        }
+        next = pos;
+    }
+
+    std::vector<result_holder> results;
+    for (auto& f : finished) {
+        results.push_back(std::move(f.second));
+    }
+    return results;
+}
+
+using spec_batch_f = std::function<std::vector<result_holder>(const std::vector<test_spec>&)>;
+
+std::vector<result_holder> refine_sweep(const std::vector<test_spec>& coarse, const spec_batch_f& run);
+
+/**
+ * Measure the overhead of the given clock and the stamps, then run all the specs
+ * in the given order, timing each trial with CLOCK. With --sweep=adaptive the specs
+ * are the coarse sweep, which is then refined around the knees.
+ */
+template <typename CLOCK>
+std::vector<result_holder> run_all(const std::vector<test_spec>& specs, StampConfig& config, const std::string& order) {
+    CLOCK::init();
+
+    auto o = measure_overhead<CLOCK>(config);
+    stamp_overhead_ns = o.stamps.get_nanos();
+    empty_call_ns = o.call_nanos;
+    fmt::print(out, "timer overhead       : {} ns clock, {:.1f} ns stamps, {:.2f} ns per empty call ({})\n", o.clock_nanos,
+            stamp_overhead_ns, empty_call_ns, arg_no_overhead ? "not subtracted" : "subtracted");
+    if (!arg_no_overhead) {
+        clock_overhead_ns = o.clock_nanos;
+        clock_overhead_cycles = o.clock_cycles;
+        call_overhead_ns = o.call_nanos;
+        call_overhead_cycles = o.call_cycles;
+        config.set_overhead(o.stamps);
+        config.set_call_overhead(o.calls, overhead::CALLS);
+    }
+
+    auto run = [&](const std::vector<test_spec>& batch) {
+        if (order == "sequential") {
+            std::vector<result_holder> results;
+            for (auto& spec : batch) {
+                results.push_back(run_test<CLOCK>(spec, config));
+            }
+            return results;
+        }
+        return run_interleaved<CLOCK>(batch, config, order == "random", arg_seed.Get());
+    };
+
+    return sweep_metric ? refine_sweep(specs, run) : run(specs);
+}
+
+/**
+ * Calls the test function continuously for the given number of seconds and, after the
+ * first call to finish in each interval, takes a stamp into a preallocated ring buffer,
+ * which keeps the most recent samples if it fills up. The interval between successive
+ * stamps is returned as one result per sample, so all the per-trial columns apply.
+ */
+result_holder run_timeseries(const test_spec& spec, const StampConfig& config, double seconds, uint64_t interval_us) {
+    constexpr size_t MAX_SAMPLES = 1u << 20;
+
+    struct sample {
+        Stamp stamp;
+        uint64_t calls; // calls completed when the stamp was taken
+    };
+
+    result_holder rh{spec, 0};
+    init_buffer(spec, rh);
+    precondition_apply(pcond, spec.buf, spec.bufsz * sizeof(buf_elem));
+    warmup{arg_warm_ms.Get(), arg_warm_tol.Get() / 100.}.warm();
+
+    const uint64_t interval = interval_us * 1000;
+    std::vector<sample> ring(std::min((size_t)(seconds * 1e6 / interval_us) + 1, MAX_SAMPLES));
+    size_t count = 0;
+    uint64_t calls = 0;
+
+    ring[count++] = {config.stamp(), 0};
+    const Stamp start = ring[0].stamp;
+    uint64_t now = now_nanos(), next = now + interval, end = now + (uint64_t)(seconds * 1e9);
+    while (now < end) {
+        spec.func.func(spec.buf, spec.bufsz);
+        calls++;
+        now = now_nanos();
+        if (now >= next) {
+            ring[count++ % ring.size()] = {config.stamp(), calls};
+            next = std::max(next + interval, now);
+        }
+    }
+
+    size_t first = count > ring.size() ? count - ring.size() : 0;
+    for (size_t i = first + 1; i < count; i++) {
+        auto& prev = ring[(i - 1) % ring.size()];
+        auto& cur  = ring[i % ring.size()];
+        auto delta = config.delta(prev.stamp, cur.stamp);
+        result r{i - 1, delta, cur.calls - prev.calls, spec.bufsz, (uint64_t)delta.get_nanos(), 0.};
+        r.offset_nanos = config.delta(start, prev.stamp).get_nanos();
+        r.raw_nanos = config.raw_delta(prev.stamp, cur.stamp).get_nanos();
+        rh.results.push_back(r);
+    }
+    rh.timed_iters = rh.total_iters = calls;
+    warmup::mark_active();
+    if (count > ring.size()) {
+        fmt::print(out, "WARNING: the timeseries for id={}, bufsz={} kept only the last {} of {} samples\n",
+                spec.func.id, spec.bufsz, ring.size(), count);
+    }
     return rh;
 }
 
@@ -298,6 +1026,15 @@ struct column_base {
     virtual void update_config(StampConfig&) const {}
 
     virtual void add_to_row(Row& row, const result_holder& holder, const result& result) const = 0;
+
+    /** true if this column has a per-trial numeric value, available through value() */
+    virtual bool numeric() const { return false; }
+
+    /** get the numeric value of this column for the given trial, returning false if it isn't available */
+    virtual bool value(const result_holder&, const result&, double&) const { return false; }
+
+    /** the printf format used for values of this column */
+    virtual const char* value_format() const { return "%.2f"; }
 };
 
 using rh_extractor = std::function<void(Row& row, const result_holder& holder)>;
@@ -324,7 +1061,72 @@ rh_column make_inner(const char* name, result_holder::rh_u64 pmem, const char* f
 static rh_column col_id  {"Algo",   LEFT, [](Row& r, const result_holder& h){ r.add(h.spec.func.id); }};
 static rh_column col_ns  {"Nanos", RIGHT, [](Row& r, const result_holder& h) {
     r.addf("%.1f", h.elapsedns_stats.getMedian() / h.iters); }};
-static rh_column col_iter{"Iters", RIGHT, [](Row& r, const result_holder& h){ r.add(h.spec.iters); }};
+static rh_column col_iter{"Iters", RIGHT, [](Row& r, const result_holder& h){ r.add(h.iters); }};
+static rh_column make_latency(const char* heading, double percentile) {
+    return rh_column{heading, RIGHT, [=](Row& r, const result_holder& h) {
+        if (h.latencies) {
+            uint64_t ticks = percentile < 100 ? h.latencies->percentile(percentile) : h.latencies->max();
+            r.add(ticks_to_nanos<LatencyClock>(ticks));
+        } else {
+            r.add("-");
+        }
+    }};
+}
+
+static rh_column col_lat50  = make_latency("Lat50",   50);
+static rh_column col_lat99  = make_latency("Lat99",   99);
+static rh_column col_lat999 = make_latency("Lat99.9", 99.9);
+static rh_column col_latmax = make_latency("LatMax",  100);
+static rh_column col_ci  {"CI%",   RIGHT, [](Row& r, const result_holder& h){ r.addf("%.2f", 100 * h.median_ci); }};
+static rh_column col_reruns{"Reruns", RIGHT, [](Row& r, const result_holder& h){ r.add(h.reruns); }};
+static rh_column col_trials{"Trials", RIGHT, [](Row& r, const result_holder& h){ r.add(h.results.size()); }};
+static rh_column col_huge  {"THP%",   RIGHT, [](Row& r, const result_holder& h){
+    if (h.huge_ratio < 0) {
+        r.add("?");
+    } else {
+        r.addf("%.1f%s", 100 * h.huge_ratio, h.huge_short ? "!" : "");
+    }
+}};
+static rh_column col_phys_lo{"PhysLo", RIGHT, [](Row& r, const result_holder& h){
+    r.add(h.phys.ok ? fmt::format("{:#x}", h.phys.lo) : std::string("?"));
+}};
+static rh_column col_phys_runs{"Runs", RIGHT, [](Row& r, const result_holder& h){
+    r.add(h.phys.ok ? std::to_string(h.phys.runs) : std::string("?"));
+}};
+static rh_column col_node_pages{"NodePages", LEFT, [](Row& r, const result_holder& h){
+    std::vector<std::string> nodes;
+    for (size_t n = 0; n < h.phys.node_pages.size(); n++) {
+        if (h.phys.node_pages[n]) {
+            nodes.push_back(fmt::format("{}:{}", n, h.phys.node_pages[n]));
+        }
+    }
+    r.add(nodes.empty() ? std::string("?") : fmt::format("{}", fmt::join(nodes, ",")));
+}};
+static rh_column col_chan  {"Chan%",  LEFT,  [](Row& r, const result_holder& h){
+    auto& lines = h.phys.channel_lines;
+    double total = std::accumulate(lines.begin(), lines.end(), 0.);
+    std::vector<long> shares;
+    for (auto l : lines) {
+        shares.push_back(std::lround(100 * l / total));
+    }
+    r.add(h.phys.ok && total ? fmt::format("{}", fmt::join(shares, "/")) : std::string("?"));
+}};
+static rh_column col_chan_skew{"ChSkew", RIGHT, [](Row& r, const result_holder& h){
+    if (h.phys.ok && !h.phys.channel_lines.empty()) {
+        r.addf("%.2f", h.phys.channel_skew());
+    } else {
+        r.add("?");
+    }
+}};
+static rh_column col_node  {"Node",   LEFT,  [](Row& r, const result_holder& h){
+    std::vector<int> nodes;
+    for (int n = 0; n < 64; n++) {
+        if (h.nodes & (1ULL << n)) {
+            nodes.push_back(n);
+        }
+    }
+    r.add(nodes.empty() ? std::string("?") : fmt::format("{}", fmt::join(nodes, ",")));
+}};
 
 
 using delta_extractor = std::function<void(Row& row, const result_holder&, const result&)>;
@@ -339,13 +1141,74 @@ struct delta_column : column_base {
     }
 };
 
+static delta_column col_intr   {"Intr",    RIGHT, [](Row& row, const result_holder&, const result& res){
+    row.add(res.delta.get_interrupts() + res.delta.get_cswitches() + res.delta.get_migrations());
+}};
+static delta_column col_level  {"Level",   LEFT,  [](Row& row, const result_holder&, const result& res){
+    row.add(cache_level_for(res.buf_bytes()));
+}};
+static delta_column col_offset {"Offset",  RIGHT, [](Row& row, const result_holder& rh, const result&){ row.add(rh.spec.offset); }};
+static delta_column col_pages  {"Pages",   LEFT,  [](Row& row, const result_holder& rh, const result&){ row.add(page_backend_name(rh.spec.pages)); }};
 static delta_column col_size   {"Size",    RIGHT, [](Row& row, const result_holder&, const result& res){ row.add(res.buf_bytes()); }};
 static delta_column col_trial  {"Trial",   RIGHT, [](Row& row, const result_holder&, const result& res){ row.add(res.trial); }};
 static delta_column col_stampns{"Stampms", RIGHT, [](Row& row, const result_holder&, const result& res){
     row.addf("%0.2f", res.delta.get_nanos() / (1000000. * res.iters));
 }};
-static delta_column col_gbs{"GB/s",    RIGHT, [](Row& row, const result_holder& rh, const result& res){
-    row.addf("%.1f", (double)res.iters * rh.spec.func.work_factor * res.buf_bytes() / res.delta.get_nanos());
+using value_extractor = std::function<double(const result_holder&, const result&)>;
+
+/** a column with a numeric per-trial value */
+struct value_column : column_base {
+    const char* format;
+    value_extractor e;
+
+    value_column(const char *heading, const char* format, value_extractor e) : column_base{heading, RIGHT}, format{format}, e{e} {}
+
+    virtual void add_to_row(Row& row, const result_holder& rh, const result& result) const override {
+        row.addf(format, e(rh, result));
+    }
+
+    bool numeric() const override { return true; }
+
+    bool value(const result_holder& rh, const result& result, double& v) const override {
+        v = e(rh, result);
+        return true;
+    }
+
+    const char* value_format() const override { return format; }
+};
+
+static value_column col_gbs{"GB/s", "%.1f", [](const result_holder& rh, const result& res){
+    return (double)res.iters * rh.call_bytes() / res.delta.get_nanos();
+}};
+using value_predicate = std::function<bool(const result_holder&, const result&)>;
+
+/** a value_column which only applies to some results, showing - (and having no value) for the others */
+struct optional_column : value_column {
+    value_predicate applies;
+
+    optional_column(const char *heading, const char* format, value_predicate applies, value_extractor e)
+            : value_column{heading, format, e}, applies{applies} {}
+
+    void add_to_row(Row& row, const result_holder& rh, const result& result) const override {
+        if (applies(rh, result)) {
+            value_column::add_to_row(row, rh, result);
+        } else {
+            row.add("-");
+        }
+    }
+
+    bool value(const result_holder& rh, const result& result, double& v) const override {
+        return applies(rh, result) && value_column::value(rh, result, v);
+    }
+};
+
+// only the object based algos have objects
+static optional_column col_objs{"Mobj/s", "%.1f",
+    [](const result_holder& rh, const result&){ return (bool)rh.spec.func.prepare; },
+    [](const result_holder& rh, const result& res){ return 1000. * res.iters * rh.objects / res.delta.get_nanos(); }};
+// not shown by default, Nanos per iteration for each trial, as a base for --stats
+static value_column col_trial_ns{"Nanos", "%.1f", [](const result_holder&, const result& res){
+    return (double)res.nanos / res.iters;
 }};
 
 enum NormStyle {
@@ -354,6 +1217,66 @@ enum NormStyle {
     PER_NANO
 };
 
+static value_column col_cycles{"Cyc/CL", "%.2f", [](const result_holder& rh, const result& res){
+    return res.cycles / (res.iters * rh.call_bytes() / CACHE_LINE_BYTES);
+}};
+
+static value_column col_state{"State%", "%.1f", [](const result_holder&, const result& res){
+    return 100 * res.state_ratio;
+}};
+
+static value_column col_first_gbs{"1stGB/s", "%.1f", [](const result_holder& rh, const result& res){
+    return rh.call_bytes() / res.first_nanos;
+}};
+
+// with a single call per trial there is no rest
+static optional_column col_rest_gbs{"RestGB/s", "%.1f",
+    [](const result_holder&, const result& res){ return res.iters >= 2; },
+    [](const result_holder& rh, const result& res){
+        return (res.iters - 1) * rh.call_bytes() / (res.nanos - std::min(res.first_nanos, res.nanos));
+    }};
+
+// page faults in the trial per MB of buffer, like Copies/MB
+static value_column col_faults_mb{"Faults/MB", "%.1f", [](const result_holder&, const result& res){
+    return res.delta.get_faults() / (res.buf_bytes() / 1000000.);
+}};
+
+static value_column col_copies_mb{"Copies/MB", "%.1f", [](const result_holder&, const result& res){
+    return res.cow_copies / (res.buf_bytes() / 1000000.);
+}};
+
+static value_column col_kern_pct{"Kern%", "%.1f", [](const result_holder&, const result& res){
+    auto total = res.delta.get_user() + res.delta.get_kernel();
+    return total ? 100. * res.delta.get_kernel() / total : 0.;
+}};
+
+// the trial time spent in the kernel, per fault
+static value_column col_fault_ns{"ns/Fault", "%.0f", [](const result_holder&, const result& res){
+    auto total = res.delta.get_user() + res.delta.get_kernel(), faults = res.delta.get_faults();
+    return total && faults ? (double)res.nanos * res.delta.get_kernel() / total / faults : 0.;
+}};
+
+static delta_column col_sync_ms{"Syncms", RIGHT, [](Row& row, const result_holder&, const result& res){
+    if (res.sync_nanos < 0) {
+        row.add("-");
+    } else {
+        row.addf("%.3f", res.sync_nanos / 1000000.);
+    }
+}};
+
+static delta_column col_sync_gbs{"SyncGB/s", RIGHT, [](Row& row, const result_holder&, const result& res){
+    if (res.sync_nanos <= 0) {
+        row.add("-");
+    } else {
+        row.addf("%.2f", (double)res.buf_bytes() / res.sync_nanos);
+    }
+}};
+
+static value_column col_overhead{"Ovhd%", "%.2f", [](const result_holder&, const result& res){
+    // the raw delta, since with --no-overhead-sub the delta already includes the overhead
+    return res.raw_nanos ? 100. * (stamp_overhead_ns + res.iters * empty_call_ns) / res.raw_nanos : 0.;
+}};
+
 static PerfEvent NoEvent{""};
 
 class event_column : public column_base {
@@ -366,25 +1289,37 @@ public:
     event_column(const std::string& heading, const std::string& format, PerfEvent top, NormStyle norm = NONE)
         : column_base{heading, RIGHT}, format{format}, top{top}, bottom{NoEvent}, norm{norm} {}
 
-    virtual void add_to_row(Row& row, const result_holder& rh, const result& result) const {
+    virtual void add_to_row(Row& row, const result_holder& rh, const result& result) const override {
+        double v;
+        if (value(rh, result, v)) {
+            row.addf(format.c_str(), v);
+        } else {
+            row.add("FAIL");
+        }
+    }
+
+    bool numeric() const override { return true; }
+
+    bool value(const result_holder& rh, const result& result, double& v) const override {
         try {
-            auto v = get_value(result.delta);
+            v = get_value(result.delta);
             switch (norm) {
                 case PER_CL:
-                    v /= (result.buf_bytes() * rh.spec.func.work_factor * result.iters / CACHE_LINE_BYTES);
+                    v /= (rh.call_bytes() * result.iters / CACHE_LINE_BYTES);
                     break;
                 case PER_NANO:
                     v /= result.delta.get_nanos();
                 case NONE:
                     ;
             };
-
-            row.addf(format.c_str(), v);
+            return true;
         } catch (const Failed&) {
-            row.add("FAIL");
+            return false;
         }
     }
 
+    const char* value_format() const override { return format.c_str(); }
+
     double get_value(const StampDelta& delta) const {
         return value(delta, top) / (is_ratio() ? value(delta, bottom) : 1.);
     }
@@ -409,9 +1344,99 @@ private:
     }
 };
 
+/**
+ * A statistic of one of the --stats kinds, calculated over all the trials of a spec.
+ */
+struct stat_kind {
+    enum Kind { PERCENTILE, MEAN, STDDEV, MAD, CI_LO, CI_HI, COUNT } kind;
+    double p; // the percentile, for PERCENTILE
+
+    /** parse a stat name such as p99 or stddev, throwing usage_error if it isn't valid */
+    static stat_kind parse(const std::string& name) {
+        static const std::vector<std::pair<std::string, Kind>> names = {
+            {"mean", MEAN}, {"stddev", STDDEV}, {"mad", MAD}, {"ci-lo", CI_LO}, {"ci-hi", CI_HI}, {"n", COUNT}
+        };
+        for (auto& n : names) {
+            if (n.first == name) {
+                return {n.second, 0};
+            }
+        }
+        if (name.size() > 1 && name[0] == 'p') {
+            char* end;
+            double p = strtod(name.c_str() + 1, &end);
+            if (*end == '\0' && p >= 0 && p <= 100) {
+                return {PERCENTILE, p};
+            }
+        }
+        throw usage_error("unknown stat: " + name);
+    }
+
+    double get(const Summary& s) const {
+        switch (kind) {
+            case PERCENTILE: return s.percentile(p);
+            case MEAN:       return s.getMean();
+            case STDDEV:     return s.getStddev();
+            case MAD:        return s.getMAD();
+            case CI_LO:      return s.bootstrapCI().first;
+            case CI_HI:      return s.bootstrapCI().second;
+            case COUNT:      return s.getCount();
+        }
+        assert(false);
+        return 0;
+    }
+};
+
+/**
+ * Shows a statistic of a numeric base column over all the trials of the spec, so the
+ * value is the same for every row of a spec.
+ */
+class stat_column : public column_base {
+    const column_base& base;
+    stat_kind kind;
+    double reject_k;
+
+    // rows arrive spec by spec, so caching the last spec avoids recalculating for every row. The
+    // cache is keyed on the serial since holders often reuse an address, e.g., with --stream
+    mutable uint64_t cached_serial = 0;
+    mutable std::string cached;
+
+public:
+    stat_column(const column_base& base, const std::string& stat, double reject_k)
+        : column_base{base.heading + ":" + stat, RIGHT}, base{base}, kind{stat_kind::parse(stat)}, reject_k{reject_k} {}
+
+    void update_config(StampConfig& sc) const override {
+        base.update_config(sc);
+    }
+
+    void add_to_row(Row& row, const result_holder& holder, const result&) const override {
+        if (cached_serial != holder.serial) {
+            cached_serial = holder.serial;
+            std::vector<double> values;
+            for (auto& res : holder.results) {
+                double v;
+                if (!base.value(holder, res, v)) {
+                    cached = "FAIL";
+                    row.add(cached);
+                    return;
+                }
+                values.push_back(v);
+            }
+            Summary summary(values.begin(), values.end(), reject_k);
+            cached = table::string_format(kind.kind == stat_kind::COUNT ? "%.0f" : base.value_format(), kind.get(summary));
+        }
+        row.add(cached);
+    }
+};
+
 using collist = std::vector<const column_base *>;
 
-auto basic_cols = collist{&col_size, &col_id, &col_trial, &col_stampns, &col_gbs, &col_iter};
+static delta_column col_sample{"Sample", RIGHT, [](Row& row, const result_holder&, const result& res){ row.add(res.trial); }};
+static delta_column col_micros{"Micros", RIGHT, [](Row& row, const result_holder&, const result& res){
+    row.addf("%.1f", res.offset_nanos / 1000.);
+}};
+static delta_column col_calls {"Calls",  RIGHT, [](Row& row, const result_holder&, const result& res){ row.add(res.iters); }};
+
+auto basic_cols = collist{&col_size, &col_id, &col_trial, &col_stampns, &col_gbs, &col_iter, &col_ci, &col_trials};
 
 const PerfEvent UNC_READS("unc_arb_trk_requests.drd_direct",
     "uncore_arb/event=0x81,umask=0x02/");
@@ -434,9 +1459,166 @@ const std::vector<event_column> perf_cols = {
     {"l2-out-non-silent", "%.2f", L2_OUT_NON_SILENT, PER_CL},
 };
 
-void report_results(const collist cols, const std::vector<result_holder>& results_list) {
+/* the cache hierarchy on one line, e.g., "L1 48 KiB, L2 2048 KiB, L3 32 MiB shared by 16" */
+static std::string describe_caches() {
+    std::string s;
+    for (auto& level : get_cache_levels()) {
+        s += s.empty() ? "" : ", ";
+        s += level.name() + " " + (level.size % (1 << 20) ? fmt::format("{} KiB", level.size >> 10) : fmt::format("{} MiB", level.size >> 20));
+        if (level.shared_by > 1) {
+            s += fmt::format(" shared by {}", level.shared_by);
+        }
+    }
+    return s.empty() ? "unknown" : s;
+}
 
-    // report
+/**
+ * The extra sizes for --sweep=caches: dense steps from 0.7x to 1.4x of the capacity of each
+ * cache level and, for levels shared between cores, of the share of one core when all the
+ * cores sharing it are busy (SMT siblings don't count, since they share the core's caches anyway). Only sizes from minsz to maxsz are included.
+ */
+static std::vector<size_t> cache_sweep_sizes(size_t minsz, size_t maxsz) {
+    std::vector<size_t> sizes;
+    for (auto& level : get_cache_levels()) {
+        std::vector<double> capacities{(double)level.size};
+        if (level.shared_cores > 1) {
+            capacities.push_back((double)level.size / level.shared_cores);
+        }
+        for (double capacity : capacities) {
+            for (double f = 0.7; f < 1.41; f *= 1.05) {
+                size_t bytesz = capacity * f;
+                if (bytesz >= minsz && bytesz <= maxsz) {
+                    sizes.push_back(bytesz);
+                }
+            }
+        }
+    }
+    return sizes;
+}
+
+/*
+ * Add a spec for each of algos, each of the page backends and each of the buffer offsets,
+ * with a buffer of elemsz elements.
+ */
+static size_t skipped_obj_specs; // the specs add_size_specs left out because their buffer holds no objects
+
+static void add_size_specs(std::vector<test_spec>& specs, const std::vector<test_func>& algos, size_t elemsz) {
+    size_t bytesz = elemsz * sizeof(buf_elem);
+    auto iters = std::max((arg_target_size.Get() + bytesz - 1) / bytesz, arg_min_iters.Get());
+    for (auto& buffer : buffers) {
+        for (auto offset : buf_offsets) {
+            for (auto& algo : algos) {
+                if (algo.prepare && bytesz < scatter_obj_bytes()) {
+                    // the buffer holds no objects, so there is nothing to write
+                    static bool warned;
+                    if (!warned) {
+                        fmt::print(out, "NOTE: skipping {} and other object based algos at sizes below --obj-size {}\n",
+                                algo.id, scatter_obj_bytes());
+                        warned = true;
+                    }
+                    skipped_obj_specs++;
+                    continue;
+                }
+                test_spec s = {algo, iters, buffer.second + offset / sizeof(buf_elem), elemsz, offset, buffer.first};
+                specs.push_back(s);
+            }
+        }
+    }
+}
+
+/**
+ * The adaptive sweep: run the coarse sweep, then repeatedly find the neighbouring sizes
+ * where the median of the sweep metric differs by more than --knee percent for any algo, offset and backend
+ * (and by more than the CIs of the two medians can explain) and add the size between
+ * them (at the geometric mean), until no interval has a knee,
+ * the neighbours are within --sweep-res of each other or --sweep-budget sizes have run.
+ * The intervals with the largest changes are split first.
+ */
+std::vector<result_holder> refine_sweep(const std::vector<test_spec>& coarse, const spec_batch_f& run) {
+    assert(!coarse.empty() && sweep_metric);
+    // the algos, and every algo, offset and backend, which is what the knees are found for
+    std::vector<test_func> algos;
+    std::set<std::tuple<std::string, size_t, page_backend>> variants;
+    for (auto& spec : coarse) {
+        if (variants.emplace(spec.func.id, spec.offset, spec.pages).second
+                && spec.offset == coarse.front().offset && spec.pages == coarse.front().pages) {
+            algos.push_back(spec.func);
+        }
+    }
+    const double knee = arg_knee.Get() / 100., min_ratio = 1 + arg_sweep_res.Get() / 100.;
+    const size_t budget = arg_sweep_budget.Get();
+
+    std::set<size_t> sizes;
+    for (auto& spec : coarse) {
+        sizes.insert(spec.bufsz);
+    }
+    std::vector<result_holder> results = run(coarse);
+
+    while (sizes.size() < budget) {
+        // the median of the metric and the relative half-width of its CI, for each size and algo
+        std::map<std::tuple<size_t, std::string, size_t, page_backend>, std::pair<double, double>> medians;
+        for (auto& rh : results) {
+            std::vector<double> values;
+            for (auto& res : rh.results) {
+                double v;
+                if (sweep_metric->value(rh, res, v)) {
+                    values.push_back(v);
+                }
+            }
+            if (!values.empty()) {
+                medians[{rh.spec.bufsz, rh.spec.func.id, rh.spec.offset, rh.spec.pages}] = {median(values.begin(), values.end()), median_ci(values.begin(), values.end())};
+            }
+        }
+
+        std::vector<std::pair<double, size_t>> splits; // the change across the interval, and the size to add
+        for (auto it = sizes.begin(), next = std::next(it); next != sizes.end(); it = next++) {
+            size_t lo = *it, hi = *next, mid = std::sqrt((double)lo * hi);
+            if ((double)hi / lo < min_ratio || mid <= lo || mid >= hi) {
+                continue;
+            }
+            double change = 0;
+            for (auto& v : variants) {
+                auto l = medians.find(std::tuple_cat(std::make_tuple(lo), v)), h = medians.find(std::tuple_cat(std::make_tuple(hi), v));
+                if (l != medians.end() && h != medians.end()) {
+                    double lv = l->second.first, hv = h->second.first, scale = std::max(std::abs(lv), std::abs(hv));
+                    // a change that the CIs of the two medians can explain is noise, not a knee
+                    double noise = std::abs(lv) * l->second.second + std::abs(hv) * h->second.second;
+                    if (scale > 0 && std::abs(hv - lv) > noise) {
+                        change = std::max(change, std::abs(hv - lv) / scale);
+                    }
+                }
+            }
+            if (change > knee) {
+                splits.emplace_back(change, mid);
+            }
+        }
+        if (splits.empty()) {
+            break;
+        }
+
+        std::sort(splits.rbegin(), splits.rend());
+        std::vector<test_spec> batch;
+        size_t added = 0;
+        for (auto& split : splits) {
+            if (sizes.size() >= budget) {
+                break;
+            }
+            sizes.insert(split.second);
+            add_size_specs(batch, algos, split.second);
+            added++;
+        }
+        fmt::print(out, "adaptive sweep: adding {} sizes, {} total\n", added, sizes.size());
+        auto more = run(batch);
+        std::move(more.begin(), more.end(), std::back_inserter(results));
+    }
+
+    std::stable_sort(results.begin(), results.end(),
+            [](const result_holder& l, const result_holder& r){ return l.spec.bufsz < r.spec.bufsz; });
+    return results;
+}
+
+/* a results table with just the header row for the given columns */
+static table::Table results_table(const collist& cols) {
     table::Table table;
     table.setColColumnSeparator(" | ");
     auto &header = table.newRow();
@@ -446,17 +1628,93 @@ void report_results(const collist cols, const std::vector<result_holder>& result
         header.add(col.heading);
         table.colInfo(c).justify = col.j;
     }
+    return table;
+}
+
+/* add a row for each result in holder */
+static void add_result_rows(table::Table& table, const collist& cols, const result_holder& holder) {
+    for (const auto& res : holder.results) {
+        auto& row = table.newRow();
+        for (auto& c : cols) {
+            c->add_to_row(row, holder, res);
+        }
+    }
+}
+
+void report_results(const collist cols, const std::vector<result_holder>& results_list, bool csv = arg_csv) {
+
+    // report
+    table::Table table = results_table(cols);
 
     for (const result_holder& holder : results_list) {
-        for (const auto& res : holder.results) {
-            auto& row = table.newRow();
-            for (auto& c : cols) {
-                c->add_to_row(row, holder, res);
+        add_result_rows(table, cols, holder);
+    }
+
+    printf("%s", (csv ? table.csv_str() : table.str()).c_str());
+}
+
+/**
+ * Writes the rows of each spec as soon as it finishes, rather than once every spec has
+ * run, so a long run that dies part way still leaves the results so far, and the output
+ * can be followed live. CSV rows are written as they come, under a single header. The
+ * aligned table keeps the widest width seen so far for each column, and writes the header
+ * again whenever a column has to grow.
+ */
+class result_stream {
+    collist cols;
+    bool csv;
+    std::vector<size_t> widths; // empty until the header has been written
+
+public:
+    result_stream(collist cols, bool csv) : cols{std::move(cols)}, csv{csv} {}
+
+    void write(const result_holder& holder) {
+        auto table = results_table(cols);
+        add_result_rows(table, cols, holder);
+        std::string text;
+        if (csv) {
+            text = table.csv_str(widths.empty() ? 0 : 1);
+            widths.resize(cols.size());
+        } else {
+            auto sizes = table.colSizes();
+            bool grew = widths.empty();
+            widths.resize(sizes.size());
+            for (size_t c = 0; c < sizes.size(); c++) {
+                grew |= sizes[c] > widths[c];
+                widths[c] = std::max(widths[c], sizes[c]);
             }
+            text = table.str(widths, grew ? 0 : 1);
         }
+        printf("%s", text.c_str());
+        fflush(stdout);
+    }
+};
+
+static void spec_finished(const result_holder& holder) {
+    if (stream) {
+        stream->write(holder);
     }
+}
 
-    printf("%s", (arg_csv ? table.csv_str() : table.str()).c_str());
+/* write the full latency histogram of every spec as csv */
+void dump_histograms(const std::string& filename, const std::vector<result_holder>& results_list) {
+    table::Table table;
+    table.newRow().add("Size").add("Algo").add("LoNanos").add("HiNanos").add("Count");
+    for (const result_holder& holder : results_list) {
+        if (holder.latencies) {
+            holder.latencies->for_each([&](uint64_t lo, uint64_t hi, uint64_t count) {
+                table.newRow().add(holder.spec.bufsz * sizeof(buf_elem)).add(holder.spec.func.id)
+                        .add(ticks_to_nanos<LatencyClock>(lo)).add(ticks_to_nanos<LatencyClock>(hi)).add(count);
+            });
+        }
+    }
+    FILE* f = fopen(filename.c_str(), "w");
+    if (!f) {
+        err(EXIT_FAILURE, "failed to open histogram file %s", filename.c_str());
+    }
+    fputs(table.csv_str().c_str(), f);
+    fclose(f);
+    fmt::print(out, "Wrote latency histograms to {}\n", filename);
 }
 
 void list_tests() {
@@ -506,7 +1764,7 @@ int main(int argc, char** argv) {
 
     // if csv mode is on, only the table should go to stdout
     // the rest goes to stderr
-    out = arg_csv ? stderr : stdout;
+    out = arg_csv || arg_timeseries.Get() > 0 ? stderr : stdout;
 
     if (arg_list) {
         list_tests();
@@ -518,6 +1776,68 @@ int main(int argc, char** argv) {
     get_tsc_freq(arg_force_tsc_cal);
 #endif
 
+    if (arg_min_trials.Get() == 0 || arg_min_trials.Get() > arg_max_trials.Get()) {
+        fmt::print(stderr, "--min-trials must be at least 1 and no more than --max-trials\n");
+        exit(EXIT_FAILURE);
+    }
+
+    auto& order = arg_order.Get();
+    if (order != "sequential" && order != "round-robin" && order != "random") {
+        fmt::print(stderr, "Bad --order {}: must be sequential, round-robin or random\n", order);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!parse_precondition(arg_precondition.Get(), pcond)) {
+        fmt::print(stderr, "Bad --precondition {}: must be none, flush, clean, dirty or shared\n", arg_precondition.Get());
+        exit(EXIT_FAILURE);
+    }
+    if (!parse_buffer_state(arg_buffer_state.Get().c_str(), &bstate)) {
+        fmt::print(stderr, "Bad --buffer-state {}: must be touched, zero-page, untouched, ksm or cow\n", arg_buffer_state.Get());
+        exit(EXIT_FAILURE);
+    }
+    first_touch = arg_first_touch;
+    if (first_touch) {
+        if (bstate != STATE_TOUCHED) {
+            fmt::print(stderr, "--first-touch sets the buffer state itself, so it can't be combined with --buffer-state\n");
+            exit(EXIT_FAILURE);
+        }
+        bstate = STATE_UNTOUCHED;
+    }
+    if (bstate != STATE_TOUCHED && pcond != precondition::NONE) {
+        fmt::print(stderr, "--buffer-state {} can't be combined with --precondition, which would touch the pages\n", arg_buffer_state.Get());
+        exit(EXIT_FAILURE);
+    }
+    if (!buffer_state_init(bstate)) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (arg_hist_dump && !arg_latency) {
+        fmt::print(stderr, "--hist-dump needs --latency, which records the histograms\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (arg_timeseries.Get() > 0 && arg_ts_interval.Get() == 0) {
+        fmt::print(stderr, "--ts-interval must be at least 1\n");
+        exit(EXIT_FAILURE);
+    }
+
+    auto& imode = arg_interrupts.Get();
+    if (imode != "off" && imode != "flag" && imode != "rerun") {
+        fmt::print(stderr, "Bad --interrupts {}: must be off, flag or rerun\n", imode);
+        exit(EXIT_FAILURE);
+    }
+    rerun_interrupted = imode == "rerun";
+
+    auto& clock = arg_clock.Get();
+    std::vector<std::string> clocks{"monotonic-raw", "cycle-timer", "chrono"};
+#if USE_RDTSC
+    clocks.insert(clocks.begin(), {"rdtsc", "rdtscp", "rdpmc"});
+#endif
+    if (std::find(clocks.begin(), clocks.end(), clock) == clocks.end()) {
+        fmt::print(stderr, "Bad --clock {}: must be one of {}\n", clock, fmt::join(clocks, ", "));
+        exit(EXIT_FAILURE);
+    }
+
     bool is_root = (geteuid() == 0);
     auto minsz = arg_buf_min.Get(), maxsz = arg_buf_max.Get();
     if (arg_buf_sz) {
@@ -528,6 +1848,16 @@ int main(int argc, char** argv) {
     if (!arg_no_pin) {
         pin_to_cpu(0);
     }
+    if (pcond == precondition::SHARED) {
+        // the measuring thread is pinned to CPU 0, so the reader takes the next available one
+        auto other = std::find_if(cpus.begin(), cpus.end(), [](int cpu){ return cpu != 0; });
+        if (other == cpus.end()) {
+            fmt::print(out, "WARNING: only one CPU available, the shared precondition reader will share it\n");
+        }
+        precondition_init(pcond, other != cpus.end() && !arg_no_pin ? *other : -1);
+    } else {
+        precondition_init(pcond, -1);
+    }
 
     auto cols = basic_cols;
     if (arg_perfcols) {
@@ -550,6 +1880,7 @@ int main(int argc, char** argv) {
         }
     }
 
+
 #if USE_RDTSC
     fmt::print(out, "tsc_freq             : {} MHz ({})\n", RdtscClock::tsc_freq() / 1000000.0, get_tsc_cal_info(arg_force_tsc_cal));
 #endif
@@ -558,10 +1889,23 @@ int main(int argc, char** argv) {
     fmt::print(out, "available CPUs ({:4}): {}\n", cpus.size(), join(cpus, ", "));
     fmt::print(out, "get_nprocs_conf()    : {}\n", get_nprocs_conf());
     fmt::print(out, "get_nprocs()         : {}\n", get_nprocs());
-    fmt::print(out, "target size          : {}\n", arg_target_size.Get());
+    if (arg_trial_ms.Get() > 0) {
+        fmt::print(out, "target trial time    : {} ms (iters calibrated per spec)\n", arg_trial_ms.Get());
+    } else {
+        fmt::print(out, "target size          : {}\n", arg_target_size.Get());
+    }
+    fmt::print(out, "caches ({:5})       : {}\n", cache_levels_source(), describe_caches());
     fmt::print(out, "min buffer size      : {}\n", minsz);
     fmt::print(out, "max buffer size      : {}\n", maxsz);
     fmt::print(out, "step ratio           : {:.2f}\n", arg_step.Get());
+    fmt::print(out, "interrupt detection  : {}\n", imode);
+    fmt::print(out, "trial clock          : {}\n", clock);
+    fmt::print(out, "execution order      : {}{}\n", order, order == "random" ? fmt::format(" (seed {})", arg_seed.Get()) : "");
+    fmt::print(out, "warmup               : up to {} ms, until the frequency is stable within {}%\n", arg_warm_ms.Get(), arg_warm_tol.Get());
+    fmt::print(out, "precondition         : {}\n", arg_precondition.Get());
+    fmt::print(out, "buffer state         : {}\n", buffer_state_name(bstate));
+    fmt::print(out, "trials               : {} warmup, {} to {} measured, target CI {}%, cap {} ms\n",
+            arg_warmup_trials.Get(), arg_min_trials.Get(), arg_max_trials.Get(), arg_target_ci.Get(), arg_max_spec_ms.Get());
 
     std::vector<test_func> algos;
     if (arg_algos) {
@@ -579,15 +1923,128 @@ int main(int argc, char** argv) {
         algos.insert(algos.begin(), std::begin(ALL_FUNCS), std::end(ALL_FUNCS));
     }
 
-    // create a cache-line aligned buffer and initialize it
-    auto maxelems = maxsz / sizeof(buf_elem);
-    auto alloc_size = maxelems * sizeof(buf_elem) + BUFFER_TAIL_BYTES;
-    buf_elem* buf = static_cast<buf_elem*>(huge_alloc(alloc_size, true));
+    if (std::any_of(algos.begin(), algos.end(), [](const test_func& f){ return f.prepare == scatter_prepare; })) {
+        auto obj_size = arg_obj_size.Get();
+        if (obj_size < 16 || obj_size > 4096 || obj_size % 16) {
+            fmt::print(stderr, "Bad --obj-size {}: must be a multiple of 16 between 16 and 4096\n", obj_size);
+            exit(EXIT_FAILURE);
+        }
+        auto& pattern = arg_obj_pattern.Get();
+        if (pattern != "random" && pattern != "slab") {
+            fmt::print(stderr, "Bad --obj-pattern {}: must be random or slab\n", pattern);
+            exit(EXIT_FAILURE);
+        }
+        scatter_configure(obj_size, pattern == "slab" ? scatter_pattern::SLAB : scatter_pattern::RANDOM);
+        fmt::print(out, "scatter objects      : {} bytes ({})\n", obj_size, pattern);
+        cols.push_back(&col_objs);
+    }
+
+    if (arg_clock) {
+        cols.push_back(&col_cycles);
+    }
+
+    if (arg_overhead_col) {
+        cols.push_back(&col_overhead);
+    }
+
+    if (first_touch) {
+        cols.insert(cols.end(), {&col_state, &col_faults_mb, &col_kern_pct, &col_fault_ns});
+    } else if (bstate != STATE_TOUCHED) {
+        cols.insert(cols.end(), {&col_state, &col_first_gbs, &col_rest_gbs});
+        if (bstate == STATE_COW) {
+            cols.insert(cols.end(), {&col_faults_mb, &col_copies_mb});
+        }
+    }
+
+    if (imode != "off") {
+        cols.push_back(&col_intr);
+        if (rerun_interrupted) {
+            cols.push_back(&col_reruns);
+        }
+    }
 
-    std::fill(buf, buf + maxelems, -1);
+    if (arg_latency) {
+        cols.insert(cols.end(), {&col_lat50, &col_lat99, &col_lat999, &col_latmax});
+    }
+
+    if (arg_stats) {
+        collist bases{&col_trial_ns};
+        std::copy_if(cols.begin(), cols.end(), std::back_inserter(bases), [](const column_base* c){ return c->numeric(); });
+        for (auto& stat : split(arg_stats.Get(), ",")) {
+            for (auto base : bases) {
+                try {
+                    cols.push_back(new stat_column(*base, stat, arg_reject.Get()));
+                } catch (const usage_error& e) {
+                    fmt::print(stderr, "{}\n", e.what());
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+    }
+
+    if (arg_offset_sweep) {
+        auto step = arg_offset_sweep.Get();
+        if (step == 0 || step % sizeof(buf_elem)) {
+            fmt::print(stderr, "Bad --offset-sweep {}: must be a non-zero multiple of {}\n", step, sizeof(buf_elem));
+            exit(EXIT_FAILURE);
+        }
+        buf_offsets.clear();
+        for (size_t offset = 0; offset < 4096; offset += step) {
+            buf_offsets.push_back(offset);
+        }
+    } else if (arg_offset.Get() >= 4096 || arg_offset.Get() % sizeof(buf_elem)) {
+        fmt::print(stderr, "Bad --offset {}: must be a multiple of {} below 4096\n", arg_offset.Get(), sizeof(buf_elem));
+        exit(EXIT_FAILURE);
+    } else {
+        buf_offsets = {arg_offset.Get()};
+    }
+    if (arg_offset_sweep || arg_offset.Get()) {
+        cols.insert(std::find(cols.begin(), cols.end(), &col_id) + 1, &col_offset);
+        fmt::print(out, "buffer offsets       : {}\n", fmt::join(buf_offsets, ", "));
+    }
+
+    auto& sweep = arg_sweep.Get();
+    if (sweep == "adaptive") {
+        auto& name = arg_sweep_metric.Get();
+        collist candidates{&col_trial_ns};
+        candidates.insert(candidates.end(), cols.begin(), cols.end());
+        auto it = std::find_if(candidates.begin(), candidates.end(), [&](const column_base* c){ return c->numeric() && c->heading == name; });
+        if (it == candidates.end()) {
+            fmt::print(stderr, "Bad --sweep-metric {}: must be the heading of a numeric column, such as GB/s\n", name);
+            exit(EXIT_FAILURE);
+        }
+        sweep_metric = *it;
+        fmt::print(out, "adaptive sweep       : on {}, knee {}%, resolution {}%, budget {} sizes\n",
+                name, arg_knee.Get(), arg_sweep_res.Get(), arg_sweep_budget.Get());
+    } else if (sweep == "caches") {
+        if (get_cache_levels().empty()) {
+            fmt::print(stderr, "--sweep=caches needs the cache hierarchy, but neither sysfs nor cpuid described it\n");
+            exit(EXIT_FAILURE);
+        }
+        cols.insert(cols.begin() + 1, &col_level);
+    } else if (sweep != "geometric") {
+        fmt::print(stderr, "Bad --sweep {}: must be geometric, adaptive or caches\n", sweep);
+        exit(EXIT_FAILURE);
+    }
+
+    set_page_info_threads(arg_page_info_threads.Get());
+    page_set_file_dir(arg_file_dir.Get().c_str());
+
+    auto& sync = arg_sync.Get();
+    if (sync == "msync") {
+        sync_mode = 1;
+    } else if (sync == "fdatasync") {
+        sync_mode = 2;
+    } else if (sync != "none") {
+        fmt::print(stderr, "Bad --sync {}: must be none, msync or fdatasync\n", sync);
+        exit(EXIT_FAILURE);
+    }
+    if (sync_mode) {
+        cols.insert(cols.end(), {&col_sync_ms, &col_sync_gbs});
+    }
 
     double step_frac = arg_step.Get();
-    std::vector<test_spec> specs;
+    std::set<size_t> elemszs;
     size_t lastelem = (size_t)-1;
     for (size_t bytesz = minsz; bytesz <= maxsz; bytesz = bytesz * step_frac) {
         auto elemsz = bytesz / sizeof(buf_elem);
@@ -596,13 +2053,102 @@ int main(int argc, char** argv) {
             bytesz = elemsz * sizeof(buf_elem);
         }
         lastelem = elemsz;
+        elemszs.insert(elemsz);
+    }
+    if (sweep == "caches") {
+        for (auto bytesz : cache_sweep_sizes(minsz, maxsz)) {
+            elemszs.insert(bytesz / sizeof(buf_elem));
+        }
+    }
+
+    if (arg_io_zero) {
+        io_zero_config ioc{split(arg_io_dirs.Get(), ","), {}, arg_io_chunk.Get(), arg_min_trials.Get()};
+        for (auto elemsz : elemszs) {
+            ioc.sizes.push_back(elemsz * sizeof(buf_elem));
+        }
+        auto methods = arg_io_methods ? split(arg_io_methods.Get(), ",") : io_zero_methods();
+        for (auto& m : methods) {
+            if (std::find(io_zero_methods().begin(), io_zero_methods().end(), m) == io_zero_methods().end()) {
+                fmt::print(stderr, "Bad --io-methods {}: must be one of {}\n", m, fmt::join(io_zero_methods(), ", "));
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (ioc.chunk == 0) {
+            fmt::print(stderr, "--io-chunk must be at least 1\n");
+            exit(EXIT_FAILURE);
+        }
+        fmt::print(out, "Running I/O zeroing of {} sizes in {} with {}\n", ioc.sizes.size(), arg_io_dirs.Get(), fmt::join(methods, ", "));
+        auto table = run_io_zero(ioc, methods);
+        printf("%s", (arg_csv ? table.csv_str() : table.str()).c_str());
+        return EXIT_SUCCESS;
+    }
 
-        auto iters = std::max((arg_target_size.Get() + bytesz - 1) / bytesz, arg_min_iters.Get());
+    // create a cache-line aligned buffer for each page backend and initialize it
+    auto maxelems = maxsz / sizeof(buf_elem);
+    auto alloc_size = maxelems * sizeof(buf_elem) + buf_offsets.back() + BUFFER_TAIL_BYTES;
+    auto pages_list = split(arg_pages.Get(), ",");
+    for (auto& name : pages_list) {
+        page_backend backend;
+        if (!parse_page_backend(name.c_str(), &backend)) {
+            fmt::print(stderr, "Bad --pages {}: must be 4k, thp, hugetlb2m, hugetlb1g, memfd, file or cow\n", name);
+            exit(EXIT_FAILURE);
+        }
+        if (sync_mode && backend == PAGES_COW) {
+            fmt::print(stderr, "--sync doesn't apply to --pages=cow: its private mapping is never written back to the file\n");
+            exit(EXIT_FAILURE);
+        }
+        buf_elem* buf = static_cast<buf_elem*>(pool_alloc(alloc_size, backend, true));
+        if (!buf) {
+            exit(EXIT_FAILURE);
+        }
+        std::fill(buf, buf + maxelems + buf_offsets.back() / sizeof(buf_elem), -1);
+        if (backend == PAGES_THP && arg_huge_min.Get() > 0) {
+            double ratio = page_collapse(buf, alloc_size, arg_huge_min.Get() / 100., arg_collapse_retries.Get());
+            fmt::print(out, "huge page target     : {}%, thp buffer is {}\n", arg_huge_min.Get(),
+                    ratio < 0 ? std::string("unknown (page flags unavailable)") : fmt::format("{:.1f}% after collapsing", 100 * ratio));
+        }
+        if (std::find_if(buffers.begin(), buffers.end(), [&](const std::pair<page_backend, buf_elem*>& b){ return b.first == backend; }) == buffers.end()) {
+            buffers.emplace_back(backend, buf);
+        }
+    }
+    if (bstate == STATE_COW && std::any_of(buffers.begin(), buffers.end(),
+            [](const std::pair<page_backend, buf_elem*>& b){ return b.first != PAGES_COW; })) {
+        fmt::print(stderr, "--buffer-state=cow needs every buffer to be a private file mapping: use --pages=cow\n");
+        exit(EXIT_FAILURE);
+    }
+    if (buffers.size() > 1 || buffers.front().first != PAGES_THP) {
+        cols.insert(std::find(cols.begin(), cols.end(), &col_id) + 1, &col_pages);
+    }
+    if (arg_channel_map) {
+        if (!channel_map::parse(arg_channel_map.Get(), dram_map)) {
+            fmt::print(stderr, "Bad --channel-map {}: must be up to 8 comma separated XORs of address bits 6 to 51, e.g., 6^13,7^14\n",
+                    arg_channel_map.Get());
+            exit(EXIT_FAILURE);
+        }
+        fmt::print(out, "DRAM channel map     : {} channels from {}\n", dram_map.channels(), arg_channel_map.Get());
+    }
+    if (arg_phys_report) {
+        cols.insert(cols.end(), {&col_phys_lo, &col_phys_runs, &col_node_pages});
+        if (!dram_map.empty()) {
+            cols.insert(cols.end(), {&col_chan, &col_chan_skew});
+        }
+    }
+    check_backing = arg_backing_cols || arg_huge_min.Get() > 0;
+    if (check_backing) {
+        cols.insert(cols.end(), {&col_huge, &col_node});
+    }
 
-        for (auto& algo : algos) {
-            test_spec s = {algo, iters, buf, elemsz};
-            specs.push_back(s);
+    std::vector<test_spec> specs;
+    for (auto elemsz : elemszs) {
+        add_size_specs(specs, algos, elemsz);
+    }
+    if (specs.empty()) {
+        if (skipped_obj_specs) {
+            fmt::print(stderr, "No specs to run: every size is below --obj-size {}\n", scatter_obj_bytes());
+        } else {
+            fmt::print(stderr, "No specs to run: no algo, size, offset and page backend left to combine\n");
         }
+        exit(EXIT_FAILURE);
     }
 
     // point jevents to the right location for the event files
@@ -613,16 +2159,75 @@ int main(int argc, char** argv) {
     for (auto& col : cols) {
         col->update_config(config);
     }
+    if (imode != "off") {
+        config.im.enable();
+    }
+    if (first_touch || bstate == STATE_COW) {
+        config.fm.enable();
+    }
     config.prepare();
+    if (imode != "off" && !config.im.is_enabled()) {
+        // interrupts can't be counted here, so neither flag nor rerun on them
+        rerun_interrupted = false;
+        cols.erase(std::remove_if(cols.begin(), cols.end(),
+                [](const column_base* c){ return c == &col_intr || c == &col_reruns; }), cols.end());
+    }
+    if (first_touch) {
+        fmt::print(out, "user/kernel split    : {}\n", config.fm.has_cycles() ? "cycles" : "rusage (tick based, unavailable cycles events)");
+    }
 
     std::vector<result_holder> results_list;
+    if (arg_timeseries.Get() > 0) {
+        fmt::print(out, "Running {} timeseries of {} s, sampled every {} us\n", specs.size(), arg_timeseries.Get(), arg_ts_interval.Get());
+        for (auto& spec : specs) {
+            results_list.push_back(run_timeseries(spec, config, arg_timeseries.Get(), arg_ts_interval.Get()));
+        }
+        // GB/s and the perf columns only: the per-spec columns don't apply, and the others (e.g., Cyc/CL
+        // and 1stGB/s) need per-trial values the samples don't have
+        collist ts_cols{&col_size, &col_id, &col_sample, &col_micros, &col_calls, &col_gbs};
+        std::copy_if(cols.begin(), cols.end(), std::back_inserter(ts_cols),
+                [](const column_base* c){ return dynamic_cast<const event_column*>(c) != nullptr; });
+        report_results(ts_cols, results_list, true);
+        pool_free_all();
+        return EXIT_SUCCESS;
+    }
+
     fmt::print(out, "Running total {} benchmark specs\n", specs.size());
-    for (auto& spec : specs) {
-        results_list.push_back(run_test(spec, config));
+    if (arg_stream) {
+        stream = new result_stream(cols, arg_csv);
+    }
+#if USE_RDTSC
+    if (clock == "rdtsc") {
+        results_list = run_all<RdtscClock>(specs, config, order);
+    } else if (clock == "rdtscp") {
+        results_list = run_all<RdtscpClock>(specs, config, order);
+    } else if (clock == "rdpmc") {
+        results_list = run_all<RdpmcClock>(specs, config, order);
+    } else
+#endif
+    if (clock == "monotonic-raw") {
+        results_list = run_all<MonotonicRawClock>(specs, config, order);
+    } else if (clock == "cycle-timer") {
+        results_list = run_all<CycleTimerClock>(specs, config, order);
+    } else {
+        assert(clock == "chrono");
+        results_list = run_all<StdClock<std::chrono::high_resolution_clock>>(specs, config, order);
+    }
+
+    if (!stream) {
+        report_results(cols, results_list);
     }
 
-    report_results(cols, results_list);
+    auto short_specs = std::count_if(results_list.begin(), results_list.end(), [](const result_holder& rh){ return rh.huge_short; });
+    if (short_specs) {
+        fmt::print(out, "WARNING: {} specs were below --huge-min {}% huge pages, flagged with ! in THP%\n", short_specs, arg_huge_min.Get());
+    }
+
+    if (arg_hist_dump) {
+        dump_histograms(arg_hist_dump.Get(), results_list);
+    }
 
+    pool_free_all();
     return EXIT_SUCCESS;
 }
 
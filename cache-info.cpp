@@ -0,0 +1,136 @@
+/*
+ * cache-info.cpp
+ */
+
+#include "cache-info.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <utility>
+
+#if USE_RDTSC
+#include "cpuid.hpp"
+#endif
+
+static const char* source = "none";
+
+static bool read_line(const std::string& path, std::string& line) {
+    std::ifstream in{path};
+    return in && std::getline(in, line);
+}
+
+/* parse a size like 48K */
+static size_t parse_size(const std::string& s) {
+    char* end;
+    size_t size = strtoull(s.c_str(), &end, 10);
+    switch (*end) {
+        case 'K': return size << 10;
+        case 'M': return size << 20;
+        case 'G': return size << 30;
+    }
+    return size;
+}
+
+/* the CPUs in a cpu list like 0-3,8-11 */
+static std::vector<long> list_cpus(const std::string& list) {
+    std::vector<long> cpus;
+    const char* p = list.c_str();
+    while (*p) {
+        char* end;
+        long lo = strtol(p, &end, 10), hi = lo;
+        if (end == p) {
+            break;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+        }
+        for (long cpu = lo; cpu <= hi; cpu++) {
+            cpus.push_back(cpu);
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return cpus;
+}
+
+/* count the physical cores the given CPUs belong to, or the CPUs if the topology isn't available */
+static int count_cores(const std::vector<long>& cpus) {
+    std::set<std::pair<std::string, std::string>> cores; // package and core id
+    for (long cpu : cpus) {
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/", package, core;
+        if (!read_line(dir + "physical_package_id", package) || !read_line(dir + "core_id", core)) {
+            return std::max((int)cpus.size(), 1);
+        }
+        cores.insert({package, core});
+    }
+    return std::max((int)cores.size(), 1);
+}
+
+static std::vector<cache_level> from_sysfs() {
+    std::vector<cache_level> levels;
+    for (int index = 0; ; index++) {
+        std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/", level, type, size, shared;
+        if (!read_line(dir + "level", level) || !read_line(dir + "type", type) || !read_line(dir + "size", size)) {
+            break;
+        }
+        if (type == "Instruction") {
+            continue;
+        }
+        read_line(dir + "shared_cpu_list", shared);
+        auto cpus = list_cpus(shared);
+        levels.push_back({atoi(level.c_str()), parse_size(size), std::max((int)cpus.size(), 1), count_cores(cpus)});
+    }
+    return levels;
+}
+
+#if USE_RDTSC
+static std::vector<cache_level> from_cpuid() {
+    std::vector<cache_level> levels;
+    // the sharing from leaf 4 counts logical CPUs, so divide by the threads per core for the cores
+    int smt_shift = get_smt_shift(), threads = smt_shift > 0 ? 1 << smt_shift : 1;
+    for (auto& c : get_cpuid_caches()) {
+        if (c.type != 'I') {
+            levels.push_back({c.level, c.size, c.sharing, std::max(c.sharing / threads, 1)});
+        }
+    }
+    return levels;
+}
+#endif
+
+static std::vector<cache_level> get_cache_levels_inner() {
+    auto levels = from_sysfs();
+    if (!levels.empty()) {
+        source = "sysfs";
+    }
+#if USE_RDTSC
+    else {
+        levels = from_cpuid();
+        if (!levels.empty()) {
+            source = "cpuid";
+        }
+    }
+#endif
+    std::sort(levels.begin(), levels.end(), [](const cache_level& l, const cache_level& r){ return l.level < r.level; });
+    return levels;
+}
+
+const std::vector<cache_level>& get_cache_levels() {
+    static std::vector<cache_level> cached = get_cache_levels_inner();
+    return cached;
+}
+
+const char* cache_levels_source() {
+    get_cache_levels();
+    return source;
+}
+
+std::string cache_level_for(size_t bytes) {
+    for (auto& level : get_cache_levels()) {
+        if (bytes <= level.size) {
+            return level.name();
+        }
+    }
+    return "DRAM";
+}
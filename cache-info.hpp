@@ -0,0 +1,37 @@
+/*
+ * cache-info.hpp
+ *
+ * The data cache hierarchy of the CPU we are running on.
+ */
+
+#ifndef CACHE_INFO_HPP_
+#define CACHE_INFO_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct cache_level {
+    int level;
+    std::size_t size; // bytes in one instance of the cache
+    int shared_by;    // logical CPUs sharing one instance
+    int shared_cores; // physical cores sharing one instance, so 1 for a per-core cache even with SMT
+
+    /** e.g., "L1" */
+    std::string name() const { return "L" + std::to_string(level); }
+};
+
+/**
+ * The data and unified caches, lowest level first, from sysfs if it is available, otherwise
+ * from cpuid leaf 4 (only on USE_RDTSC builds). Empty if neither source is available.
+ * Cached after the first call.
+ */
+const std::vector<cache_level>& get_cache_levels();
+
+/** where get_cache_levels() got its information: "sysfs", "cpuid" or "none" */
+const char* cache_levels_source();
+
+/** the name of the level a buffer of the given size fits in, e.g., "L2", or "DRAM" if it fits in none */
+std::string cache_level_for(std::size_t bytes);
+
+#endif /* CACHE_INFO_HPP_ */
@@ -13,6 +13,13 @@ constexpr size_t BUFFER_TAIL_BYTES = 128;
 using buf_elem = int;
 using cal_f = void(buf_elem* buf, size_t bufsz);
 
+/**
+ * Called outside of the timed region before a spec runs, returns the number
+ * of objects each call of the function touches, or 0 if the function isn't
+ * object based.
+ */
+using prep_f = size_t(buf_elem* buf, size_t bufsz);
+
 cal_f memset0;
 cal_f memset1;
 cal_f fill0;
@@ -54,3 +61,23 @@ cal_f fill512_0;
 cal_f fill512_1;
 #endif
 
+/**
+ * The scatter kernels zero a list of small objects inside the buffer, rather
+ * than the whole buffer, like an allocator which clears objects as they are
+ * freed. The object list is generated by scatter_prepare, which must be
+ * called before the kernels whenever the buffer size changes.
+ */
+enum class scatter_pattern {
+    RANDOM, // objects are picked from random slots, in random order
+    SLAB    // every other object slot, in address order
+};
+
+void scatter_configure(size_t obj_bytes, scatter_pattern pattern);
+size_t scatter_obj_bytes();
+prep_f scatter_prepare;
+
+cal_f scatter_scalar;
+cal_f scatter_avx2;
+cal_f scatter_vpscatter;
+cal_f scatter_stosb;
+
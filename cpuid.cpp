@@ -86,6 +86,16 @@ std::string get_brand_string() {
     return ret;
 }
 
+std::string get_vendor_string() {
+    auto leaf0 = cpuid(0);
+    char buf[13];
+    memcpy(buf + 0, &leaf0.ebx, 4);
+    memcpy(buf + 4, &leaf0.edx, 4);
+    memcpy(buf + 8, &leaf0.ecx, 4);
+    buf[12] = '\0';
+    return buf;
+}
+
 /* get bits [start:end] inclusive of the given value */
 uint32_t get_bits(uint32_t value, int start, int end) {
     value >>= start;
@@ -121,3 +131,26 @@ int get_smt_shift()
     return smtShift;
 }
 
+
+std::vector<cpuid_cache> get_cpuid_caches() {
+    std::vector<cpuid_cache> caches;
+    if (cpuid_highest_leaf() < 4) {
+        return caches;
+    }
+    for (int subleaf = 0; ; subleaf++) {
+        cpuid_result leaf4 = cpuid(4, subleaf);
+        uint32_t type = get_bits(leaf4.eax, 0, 4);
+        if (type == 0) {
+            break;
+        }
+        cpuid_cache c;
+        c.level   = get_bits(leaf4.eax, 5, 7);
+        c.type    = type == 1 ? 'D' : type == 2 ? 'I' : 'U';
+        c.sharing = get_bits(leaf4.eax, 14, 25) + 1;
+        // ways * partitions * line size * sets
+        c.size    = (size_t)(get_bits(leaf4.ebx, 22, 31) + 1) * (get_bits(leaf4.ebx, 12, 21) + 1)
+                  * (get_bits(leaf4.ebx, 0, 11) + 1) * (leaf4.ecx + 1);
+        caches.push_back(c);
+    }
+    return caches;
+}
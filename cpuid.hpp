@@ -6,7 +6,9 @@
 #define CPUID_HPP_
 
 #include <cinttypes>
+#include <cstddef>
 #include <string>
+#include <vector>
 
 struct cpuid_result {
     std::uint32_t eax, ebx, ecx, edx;
@@ -27,6 +29,14 @@ struct family_model {
 };
 
 
+/** a cache described by cpuid leaf 4 */
+struct cpuid_cache {
+    int level;
+    char type;         // 'D'ata, 'I'nstruction or 'U'nified
+    std::size_t size;  // in bytes
+    int sharing;       // the maximum number of logical processors sharing the cache
+};
+
 /** the highest supported leaf value */
 uint32_t cpuid_highest_leaf();
 
@@ -40,8 +50,14 @@ family_model get_family_model();
 
 std::string get_brand_string();
 
+/* the vendor string from leaf 0, e.g., GenuineIntel or AuthenticAMD */
+std::string get_vendor_string();
+
 int get_smt_shift();
 
+/* the caches enumerated by cpuid leaf 4 (deterministic cache parameters), empty if it isn't supported */
+std::vector<cpuid_cache> get_cpuid_caches();
+
 /* get bits [start:end] inclusive of the given value */
 uint32_t get_bits(uint32_t value, int start, int end);
 
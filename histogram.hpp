@@ -0,0 +1,112 @@
+/*
+ * histogram.hpp
+ *
+ * A fixed-size, log-bucketed histogram in the style of HdrHistogram.
+ */
+
+#ifndef HISTOGRAM_HPP_
+#define HISTOGRAM_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cinttypes>
+#include <cstddef>
+
+/**
+ * Records uint64_t values into buckets whose width grows with the value: values
+ * below SUB get their own bucket, and above that each power of two is split into
+ * SUB equal buckets, so every bucket is within 1/SUB (~3%) of the values it holds.
+ *
+ * All storage is inline, so record() never allocates and can be called inside a
+ * timed region.
+ */
+class LogHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 5;
+    static constexpr size_t   SUB      = 1u << SUB_BITS;
+    static constexpr size_t   BUCKETS  = (64 - SUB_BITS + 1) * SUB;
+
+    LogHistogram() : counts_{}, total_{0}, max_{0} {}
+
+    void record(uint64_t value) {
+        counts_[index(value)]++;
+        total_++;
+        max_ = std::max(max_, value);
+    }
+
+    /** add every value recorded in other to this histogram */
+    void merge(const LogHistogram& other) {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    void clear() {
+        counts_.fill(0);
+        total_ = 0;
+        max_ = 0;
+    }
+
+    uint64_t count() const { return total_; }
+
+    uint64_t max() const { return max_; }
+
+    /**
+     * The value at the given percentile (0 to 100): the highest value that falls in the
+     * same bucket as the value at that rank, capped at the largest recorded value.
+     */
+    uint64_t percentile(double p) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)(p / 100 * total_ + 0.5)), seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::min(bucket_lo(i) + bucket_width(i) - 1, max_);
+            }
+        }
+        return max_;
+    }
+
+    /** call f(lo, hi, count) for every non-empty bucket, where [lo, hi] is the range of the bucket */
+    template <typename F>
+    void for_each(F f) const {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            if (counts_[i]) {
+                f(bucket_lo(i), bucket_lo(i) + bucket_width(i) - 1, counts_[i]);
+            }
+        }
+    }
+
+    static size_t index(uint64_t value) {
+        if (value < SUB) {
+            return value;
+        }
+        unsigned shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        size_t idx = (shift + 1) * SUB + ((value >> shift) & (SUB - 1));
+        assert(idx < BUCKETS);
+        return idx;
+    }
+
+    static uint64_t bucket_lo(size_t idx) {
+        if (idx < SUB) {
+            return idx;
+        }
+        unsigned shift = idx / SUB - 1;
+        return (uint64_t)(SUB + idx % SUB) << shift;
+    }
+
+    static uint64_t bucket_width(size_t idx) {
+        return idx < SUB ? 1 : (uint64_t)1 << (idx / SUB - 1);
+    }
+
+private:
+    std::array<uint64_t, BUCKETS> counts_;
+    uint64_t total_, max_;
+};
+
+#endif /* HISTOGRAM_HPP_ */
@@ -2,58 +2,472 @@
  * huge-alloc.cpp
  */
 
+#define _GNU_SOURCE // for memfd_create
+
 #include "huge-alloc.h"
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 #include <linux/kernel-page-flags.h>
 
 #include "page-info.h"
 
 #define HUGE_PAGE_SIZE ((size_t)(2u * 1024u * 1024u))
 #define HUGE_PAGE_MASK ((size_t)-HUGE_PAGE_SIZE)
+#define GIGA_PAGE_SIZE ((size_t)(1u << 30))
 
-/* allocate size bytes of storage in a hugepage */
-void *huge_alloc(size_t user_size, bool print) {
-    if (user_size > MAX_HUGE_ALLOC) {
-        fprintf(stderr, "request exceeds MAX_HUGE_ALLOC in %s, check your math\n", __func__);
-        return 0;
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+static const char *backend_names[] = { "4k", "thp", "hugetlb2m", "hugetlb1g", "memfd", "file", "cow" };
+
+bool parse_page_backend(const char *name, page_backend *backend) {
+    for (size_t i = 0; i < sizeof(backend_names) / sizeof(backend_names[0]); i++) {
+        if (strcmp(name, backend_names[i]) == 0) {
+            *backend = (page_backend)i;
+            return true;
+        }
     }
+    return false;
+}
 
-    // we request size + 2 * HUGE_PAGE_SIZE so we'll always have at least one huge page boundary in the allocation
-    size_t mmap_size = user_size + 2 * HUGE_PAGE_SIZE;
+const char *page_backend_name(page_backend backend) {
+    return backend_names[backend];
+}
 
-    char *mmap_p = (char *)mmap(0, mmap_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+/*
+ * Every live allocation: the pointer returned to the user and the mapping it lives in,
+ * so that huge_free can unmap it. Allocations are few and long-lived, so a linear
+ * search is fine.
+ */
+typedef struct {
+    void *user_p;
+    void *mmap_p;
+    size_t mmap_size;
+    size_t user_size;
+    page_backend backend;
+    int fd; // the backing file for memfd and file allocations, otherwise -1
+} allocation;
 
-    if (mmap_p == MAP_FAILED) {
-        fprintf(stderr, "MMAP failed in %s\n", __func__);
-        return 0;
+static allocation *allocs;
+static size_t alloc_count, alloc_cap;
+
+static void record_alloc(allocation a) {
+    if (alloc_count == alloc_cap) {
+        alloc_cap = alloc_cap ? alloc_cap * 2 : 8;
+        allocs = (allocation *)realloc(allocs, alloc_cap * sizeof(allocation));
+        assert(allocs);
+    }
+    allocs[alloc_count++] = a;
+}
+
+static int huge_flag(page_backend backend) {
+    return backend == PAGES_HUGETLB_2M || backend == PAGES_HUGETLB_1G ? KPF_HUGE : KPF_THP;
+}
+
+static void print_backing(char *p, size_t size, page_backend backend) {
+    page_info_array info = get_info_for_range(p, p + size);
+    flag_count fcount = get_flag_count(info, huge_flag(backend));
+    if (size > 0 && fcount.pages_available == 0) {
+        fprintf(stderr, "failed to get any huge page info - probably you need to run as root\n");
+    } else {
+        fprintf(stderr, "hugepage ratio %4.3f (available %4.3f) for %s allocation of size %zu\n",
+            (double)fcount.pages_set/fcount.pages_available,
+            (double)fcount.pages_available/fcount.pages_total,
+            page_backend_name(backend), size);
+    }
+    free_info_array(info);
+}
+
+static const char *file_dir = ".";
+
+void page_set_file_dir(const char *dir) {
+    file_dir = dir;
+}
+
+/* open an unlinked file of the given size for the memfd or file backend, returning -1 on failure */
+static int open_backing_file(size_t size, page_backend backend) {
+    int fd;
+    char path[4096];
+    if (backend == PAGES_MEMFD || backend == PAGES_COW) {
+        fd = memfd_create("bench-buffer", 0);
+        snprintf(path, sizeof(path), "memfd");
+    } else {
+        snprintf(path, sizeof(path), "%s/bench-buffer-XXXXXX", file_dir);
+        fd = mkstemp(path);
+        if (fd >= 0) {
+            unlink(path);
+        }
+    }
+    if (fd < 0) {
+        fprintf(stderr, "failed to create the %s backing file %s: %s\n", page_backend_name(backend), path, strerror(errno));
+        return -1;
     }
+    if (ftruncate(fd, size)) {
+        fprintf(stderr, "failed to size the %s backing file to %zu bytes: %s\n", page_backend_name(backend), size, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (backend == PAGES_COW) {
+        // give the file real zeroed pages, like memory a parent zeroed before forking, rather than holes
+        static const char zeros[65536];
+        for (size_t off = 0; off < size; off += sizeof(zeros)) {
+            size_t n = size - off < sizeof(zeros) ? size - off : sizeof(zeros);
+            if (pwrite(fd, zeros, n, off) != (ssize_t)n) {
+                fprintf(stderr, "failed to fill the cow backing file: %s\n", strerror(errno));
+                close(fd);
+                return -1;
+            }
+        }
+    }
+    return fd;
+}
 
-    // align up to a hugepage boundary
-    char *aligned_p = (char *)(((uintptr_t)mmap_p + HUGE_PAGE_SIZE) & HUGE_PAGE_MASK);
+void *page_alloc(size_t user_size, page_backend backend, bool print) {
+    if (user_size > MAX_HUGE_ALLOC) {
+        fprintf(stderr, "request exceeds MAX_HUGE_ALLOC in %s, check your math\n", __func__);
+        return 0;
+    }
 
-    madvise(aligned_p, user_size + HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+    char *mmap_p, *aligned_p;
+    size_t mmap_size;
+    int fd = -1;
+    if (backend == PAGES_HUGETLB_2M || backend == PAGES_HUGETLB_1G) {
+        // hugetlb mappings are aligned to the page size, but the length must be a multiple of it
+        size_t page = backend == PAGES_HUGETLB_2M ? HUGE_PAGE_SIZE : GIGA_PAGE_SIZE;
+        mmap_size = (user_size + page - 1) / page * page;
+        int flags = MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB | (backend == PAGES_HUGETLB_2M ? MAP_HUGE_2MB : MAP_HUGE_1GB);
+        mmap_p = (char *)mmap(0, mmap_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (mmap_p == MAP_FAILED) {
+            fprintf(stderr, "%s mmap of %zu bytes failed in %s: %s (are enough pages reserved in "
+                    "/sys/kernel/mm/hugepages/hugepages-%zukB/nr_hugepages?)\n",
+                    page_backend_name(backend), mmap_size, __func__, strerror(errno), page / 1024);
+            return 0;
+        }
+        aligned_p = mmap_p;
+    } else if (backend == PAGES_MEMFD || backend == PAGES_FILE || backend == PAGES_COW) {
+        if ((fd = open_backing_file(user_size, backend)) < 0) {
+            return 0;
+        }
+        // reserve enough address space to map the file at a huge page boundary within it
+        mmap_size = user_size + 2 * HUGE_PAGE_SIZE;
+        mmap_p = (char *)mmap(0, mmap_size, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        aligned_p = (char *)(((uintptr_t)mmap_p + HUGE_PAGE_SIZE) & HUGE_PAGE_MASK);
+        if (mmap_p == MAP_FAILED ||
+                mmap(aligned_p, user_size, PROT_READ | PROT_WRITE, (backend == PAGES_COW ? MAP_PRIVATE : MAP_SHARED) | MAP_FIXED,
+                        fd, 0) == MAP_FAILED) {
+            fprintf(stderr, "%s mmap of %zu bytes failed in %s: %s\n", page_backend_name(backend), user_size, __func__, strerror(errno));
+            close(fd);
+            return 0;
+        }
+    } else {
+        // we request size + 2 * HUGE_PAGE_SIZE so we'll always have at least one huge page boundary in the allocation
+        mmap_size = user_size + 2 * HUGE_PAGE_SIZE;
+        mmap_p = (char *)mmap(0, mmap_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (mmap_p == MAP_FAILED) {
+            fprintf(stderr, "MMAP failed in %s\n", __func__);
+            return 0;
+        }
+        // align up to a hugepage boundary
+        aligned_p = (char *)(((uintptr_t)mmap_p + HUGE_PAGE_SIZE) & HUGE_PAGE_MASK);
+        madvise(aligned_p, user_size + HUGE_PAGE_SIZE, backend == PAGES_THP ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    }
 
     // touch the memory so we can get stats on it
     memset(aligned_p, 0xCC, user_size);
 
     if (print) {
-        page_info_array info = get_info_for_range(aligned_p, aligned_p + user_size);
-        flag_count fcount = get_flag_count(info, KPF_THP);
-        if (user_size > 0 && fcount.pages_available == 0) {
-            fprintf(stderr, "failed to get any huge page info - probably you need to run as root\n");
-        } else {
-            fprintf(stderr, "hugepage ratio %4.3f (available %4.3f) for allocation of size %zu\n",
-                (double)fcount.pages_set/fcount.pages_available,
-                (double)fcount.pages_available/fcount.pages_total,
-                user_size);
-        }
-        free_info_array(info);
+        print_backing(aligned_p, user_size, backend);
     }
 
+    allocation a = { aligned_p, mmap_p, mmap_size, user_size, backend, fd };
+    record_alloc(a);
     return aligned_p;
 }
+
+/* allocate size bytes of storage in a hugepage */
+void *huge_alloc(size_t user_size, bool print) {
+    return page_alloc(user_size, PAGES_THP, print);
+}
+
+void huge_free(void *p) {
+    if (!p) {
+        return;
+    }
+    for (size_t i = 0; i < alloc_count; i++) {
+        if (allocs[i].user_p == p) {
+            munmap(allocs[i].mmap_p, allocs[i].mmap_size);
+            if (allocs[i].fd >= 0) {
+                close(allocs[i].fd);
+            }
+            allocs[i] = allocs[--alloc_count];
+            return;
+        }
+    }
+    fprintf(stderr, "%s: %p was not allocated by huge_alloc\n", __func__, p);
+    assert(false);
+}
+
+/* the pool holds at most one buffer per backend, the largest requested so far */
+static void *pool[sizeof(backend_names) / sizeof(backend_names[0])];
+static size_t pool_sizes[sizeof(backend_names) / sizeof(backend_names[0])];
+
+void *pool_alloc(size_t size, page_backend backend, bool print) {
+    if (pool[backend] && pool_sizes[backend] >= size) {
+        return pool[backend];
+    }
+    void *p = page_alloc(size, backend, print);
+    if (p) {
+        huge_free(pool[backend]);
+        pool[backend] = p;
+        pool_sizes[backend] = size;
+    }
+    return p;
+}
+
+void pool_free_all(void) {
+    for (size_t i = 0; i < sizeof(pool) / sizeof(pool[0]); i++) {
+        huge_free(pool[i]);
+        pool[i] = 0;
+        pool_sizes[i] = 0;
+    }
+}
+
+double page_huge_ratio(void *p, size_t size, page_backend backend) {
+    page_info_array info = get_info_for_range(p, (char *)p + size);
+    flag_count fcount = get_flag_count(info, huge_flag(backend));
+    free_info_array(info);
+    return fcount.pages_available ? (double)fcount.pages_set / fcount.pages_available : -1;
+}
+
+double page_collapse(void *p, size_t size, double min_ratio, int retries) {
+    double ratio = page_huge_ratio(p, size, PAGES_THP);
+    // MADV_COLLAPSE wants a huge page aligned range, and only whole huge pages can be collapsed
+    char *start = (char *)(((uintptr_t)p + HUGE_PAGE_SIZE - 1) & HUGE_PAGE_MASK);
+    char *end = (char *)(((uintptr_t)p + size) & HUGE_PAGE_MASK);
+    for (int i = 0; i < retries && ratio >= 0 && ratio < min_ratio && start < end; i++) {
+        if (madvise(start, end - start, MADV_COLLAPSE)) {
+            fprintf(stderr, "MADV_COLLAPSE failed (attempt %d of %d): %s\n", i + 1, retries, strerror(errno));
+            if (errno == EINVAL) {
+                break; // not supported by this kernel: retrying won't help
+            }
+        }
+        ratio = page_huge_ratio(p, size, PAGES_THP);
+    }
+    return ratio;
+}
+
+bool page_node_counts(void *p, size_t size, size_t *counts, size_t max_nodes) {
+    enum { BATCH = 512 };
+    void *pages[BATCH];
+    int status[BATCH];
+    const size_t page = 4096;
+    char *start = (char *)((uintptr_t)p & ~(page - 1)), *end = (char *)p + size;
+    while (start < end) {
+        size_t count = 0;
+        for (; count < BATCH && start < end; count++, start += page) {
+            pages[count] = start;
+        }
+        // move_pages with no target nodes only reports the node of each page
+        if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0)) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (status[i] >= 0 && (size_t)status[i] < max_nodes) {
+                counts[status[i]]++;
+            }
+        }
+    }
+    return true;
+}
+
+unsigned long long page_node_mask(void *p, size_t size) {
+    size_t counts[64] = {};
+    unsigned long long mask = 0;
+    if (page_node_counts(p, size, counts, 64)) {
+        for (int n = 0; n < 64; n++) {
+            if (counts[n]) {
+                mask |= 1ULL << n;
+            }
+        }
+    }
+    return mask;
+}
+
+static const char *state_names[] = { "touched", "zero-page", "untouched", "ksm", "cow" };
+
+bool parse_buffer_state(const char *name, buffer_state *state) {
+    for (size_t i = 0; i < sizeof(state_names) / sizeof(state_names[0]); i++) {
+        if (strcmp(name, state_names[i]) == 0) {
+            *state = (buffer_state)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *buffer_state_name(buffer_state state) {
+    return state_names[state];
+}
+
+bool buffer_state_init(buffer_state state) {
+    if (state == STATE_KSM) {
+        FILE *f = fopen("/sys/kernel/mm/ksm/run", "r");
+        int run = 0;
+        if (!f || fscanf(f, "%d", &run) != 1 || run != 1) {
+            fprintf(stderr, "the ksm buffer state needs KSM running: echo 1 > /sys/kernel/mm/ksm/run\n");
+            if (f) {
+                fclose(f);
+            }
+            return false;
+        }
+        fclose(f);
+    }
+    return true;
+}
+
+/* the share of pages in infos in the given state, or -1 if unknown */
+static double state_ratio(page_info_array info, buffer_state state) {
+    size_t in_state = 0, known = 0;
+    for (size_t i = 0; i < info.num_pages; i++) {
+        page_info pi = info.info[i];
+        if (state == STATE_UNTOUCHED) {
+            // the pagemap alone is enough: an untouched page isn't present
+            in_state += !pi.present;
+            known++;
+        } else if (state == STATE_COW) {
+            // and a page still shared with the file is a file page, while a private copy is anonymous
+            in_state += pi.present && pi.file;
+            known++;
+        } else if (pi.kpageflags_ok) {
+            uint64_t flags = pi.kpageflags;
+            if (state == STATE_ZERO_PAGE) {
+                in_state += (flags >> KPF_ZERO_PAGE) & 1;
+            } else if (state == STATE_KSM) {
+                // with use_zero_pages, KSM merges zero pages into the zero page rather than a KSM page
+                in_state += ((flags >> KPF_KSM) & 1) || ((flags >> KPF_ZERO_PAGE) & 1);
+            } else {
+                in_state += !((flags >> KPF_ZERO_PAGE) & 1) && !((flags >> KPF_KSM) & 1);
+            }
+            known++;
+        }
+    }
+    return known ? (double)in_state / known : -1;
+}
+
+static double range_state_ratio(char *p, size_t size, buffer_state state) {
+    page_info_array info = get_info_for_range(p, p + size);
+    double ratio = state_ratio(info, state);
+    free_info_array(info);
+    return ratio;
+}
+
+/*
+ * Widen [p, p + size) to the pages it touches, since only whole pages can be dropped. For the
+ * thp and hugetlb backends these are the huge pages: dropping only part of a THP splits it, so
+ * the next trial would fault in 4K pages, and hugetlb pages can't be split at all.
+ */
+static void state_range(void *p, size_t size, char **start, char **end) {
+    size_t page = 4096;
+    char *limit = NULL;
+    for (size_t i = 0; i < alloc_count; i++) {
+        char *mmap_p = (char *)allocs[i].mmap_p;
+        if ((char *)p >= mmap_p && (char *)p < mmap_p + allocs[i].mmap_size) {
+            page_backend backend = allocs[i].backend;
+            if (backend == PAGES_THP || backend == PAGES_HUGETLB_2M) {
+                page = HUGE_PAGE_SIZE;
+            } else if (backend == PAGES_HUGETLB_1G) {
+                page = GIGA_PAGE_SIZE;
+            }
+            limit = mmap_p + allocs[i].mmap_size;
+            break;
+        }
+    }
+    *start = (char *)((uintptr_t)p & ~(page - 1));
+    *end = (char *)(((uintptr_t)p + size + page - 1) & ~(page - 1));
+    if (limit && *end > limit) {
+        *end = limit;
+    }
+}
+
+double buffer_state_apply(void *p, size_t size, buffer_state state, unsigned wait_ms) {
+    const size_t page = 4096;
+    char *start, *end;
+    state_range(p, size, &start, &end);
+    switch (state) {
+    case STATE_TOUCHED:
+        break;
+    case STATE_ZERO_PAGE:
+    case STATE_UNTOUCHED:
+    case STATE_COW:
+        // for a private file mapping, this drops the private copies, leaving the file pages
+        madvise(start, end - start, MADV_DONTNEED);
+        if (state != STATE_UNTOUCHED) {
+            // a read fault on an unmapped anonymous page maps the zero page, and on a private
+            // file mapping maps the file page read-only, so the next write copies it
+            for (char *q = start; q < end; q += page) {
+                (void)*(volatile char *)q;
+            }
+        }
+        break;
+    case STATE_KSM: {
+        memset(start, 0, end - start);
+        if (madvise(start, end - start, MADV_MERGEABLE)) {
+            fprintf(stderr, "MADV_MERGEABLE failed: %s\n", strerror(errno));
+            return -1;
+        }
+        struct timespec poll = { 0, 10 * 1000 * 1000 };
+        for (unsigned waited = 0; waited < wait_ms; waited += 10) {
+            double ratio = range_state_ratio(start, end - start, state);
+            if (ratio < 0 || ratio >= 0.99) {
+                return ratio;
+            }
+            nanosleep(&poll, NULL);
+        }
+        break;
+    }
+    }
+    return range_state_ratio(start, end - start, state);
+}
+
+double buffer_state_ratio(void *p, size_t size, buffer_state state) {
+    char *start, *end;
+    state_range(p, size, &start, &end);
+    return range_state_ratio(start, end - start, state);
+}
+
+int page_sync(void *p, size_t size, bool data_sync) {
+    for (size_t i = 0; i < alloc_count; i++) {
+        char *start = allocs[i].user_p;
+        if ((char *)p >= start && (char *)p < start + allocs[i].user_size) {
+            if (allocs[i].fd < 0 || allocs[i].backend == PAGES_COW) {
+                return -1; // a private mapping is never written back
+            }
+            if (data_sync) {
+                return fdatasync(allocs[i].fd);
+            }
+            char *first = (char *)((uintptr_t)p & ~(uintptr_t)4095);
+            return msync(first, (char *)p + size - first, MS_SYNC);
+        }
+    }
+    return -1;
+}
@@ -1,7 +1,8 @@
 /*
  * huge-alloc.hpp
  *
- * Inefficient allocator that allows allocating memory regions backed by THP pages.
+ * Inefficient allocator that allows allocating memory regions backed by 4K pages,
+ * THP pages, hugetlbfs 2M or 1G pages, or a shared mapping of a memfd or file.
  */
 
 #ifndef HUGE_ALLOC_HPP_
@@ -17,12 +18,113 @@
 extern "C" {
 #endif
 
+typedef enum {
+    PAGES_4K,         // 4K pages only, THP disabled with MADV_NOHUGEPAGE
+    PAGES_THP,        // transparent huge pages requested with MADV_HUGEPAGE, may fall back to 4K
+    PAGES_HUGETLB_2M, // hugetlbfs 2M pages, which must be reserved in /proc/sys/vm/nr_hugepages
+    PAGES_HUGETLB_1G, // hugetlbfs 1G pages, which must be reserved in the same way
+    PAGES_MEMFD,      // a shared mapping of a memfd, i.e., of shmem page cache pages
+    PAGES_FILE,       // a shared mapping of an unlinked file in the directory set by page_set_file_dir
+    PAGES_COW         // a private mapping of a zero filled memfd, so pages are copied on their first write
+} page_backend;
+
+/* parse a backend name: 4k, thp, hugetlb2m, hugetlb1g, memfd, file or cow, returning false if it isn't valid */
+bool parse_page_backend(const char *name, page_backend *backend);
+
+/* the name of the backend, as accepted by parse_page_backend */
+const char *page_backend_name(page_backend backend);
+
+/*
+ * Allocate size bytes with the given backend, aligned to at least 2M, and touch every
+ * page. If print is true, the share of the range actually backed by huge pages is printed.
+ * Returns NULL on failure, after printing the reason.
+ */
+void *page_alloc(size_t size, page_backend backend, bool print);
+
+/* set the directory the file backend creates its files in (default "."), e.g., a tmpfs mount */
+void page_set_file_dir(const char *dir);
+
+/*
+ * Write back the dirty pages of [p, p + size), which must be in a memfd or file allocation,
+ * with msync(MS_SYNC), or with fdatasync on the whole file if data_sync is true. Returns 0 on
+ * success or -1 if the call failed or p isn't in a memfd or file allocation (cow doesn't count).
+ */
+int page_sync(void *p, size_t size, bool data_sync);
+
 /* allocate size bytes of storage in a hugepage */
 void *huge_alloc(size_t size, bool print);
 
-/* free the pointer pointed to by p */
+/* free the pointer pointed to by p, which must have come from huge_alloc or page_alloc */
 void huge_free(void *p);
 
+/*
+ * Return a buffer of at least size bytes with the given backend from the pool, allocating
+ * it with page_alloc only if the pool has no big enough buffer with that backend, so every
+ * user of the same backend shares one buffer. Pooled buffers must not be passed to huge_free.
+ */
+void *pool_alloc(size_t size, page_backend backend, bool print);
+
+/* free every buffer in the pool */
+void pool_free_all(void);
+
+/*
+ * The share of the pages in [p, p + size) that are backed by huge pages: THP pages, or
+ * hugetlbfs pages for the hugetlb backends. Returns -1 if the page flags can't be read,
+ * usually because we aren't running as root.
+ */
+double page_huge_ratio(void *p, size_t size, page_backend backend);
+
+/*
+ * Try to raise the huge page ratio of a THP range to at least min_ratio, asking the kernel
+ * to collapse it into huge pages (MADV_COLLAPSE, where available) up to retries times.
+ * Returns the final ratio, as for page_huge_ratio.
+ */
+double page_collapse(void *p, size_t size, double min_ratio, int retries);
+
+/*
+ * A mask of the NUMA nodes backing the present pages in [p, p + size), where bit n is set
+ * for node n (nodes above 63 are not reported), or 0 if the nodes can't be determined.
+ */
+unsigned long long page_node_mask(void *p, size_t size);
+
+/*
+ * Count the present pages in [p, p + size) on each NUMA node: counts[n] is incremented for
+ * each page on node n, for n < max_nodes. Returns false if the nodes can't be determined.
+ */
+bool page_node_counts(void *p, size_t size, size_t *counts, size_t max_nodes);
+
+typedef enum {
+    STATE_TOUCHED,   // every page written and private: the normal state of a buffer
+    STATE_ZERO_PAGE, // every page read but never written, so mapped to the shared zero page
+    STATE_UNTOUCHED, // no page mapped at all, so the next access faults in a fresh page
+    STATE_KSM,       // every page zeroed and merged by KSM into one shared page
+    STATE_COW        // for the cow backend: every page mapped read-only from the file, so the next write copies it
+} buffer_state;
+
+/* parse a buffer state name: touched, zero-page, untouched, ksm or cow, returning false if it isn't valid */
+bool parse_buffer_state(const char *name, buffer_state *state);
+
+/* the name of the state, as accepted by parse_buffer_state */
+const char *buffer_state_name(buffer_state state);
+
+/*
+ * Check that the given state can be set up on this system, printing the reason and
+ * returning false if not (KSM must be running for STATE_KSM).
+ */
+bool buffer_state_init(buffer_state state);
+
+/*
+ * Put the pages of [p, p + size) into the given state, which discards their contents for
+ * every state but STATE_TOUCHED. For the thp and hugetlb backends the whole huge pages the
+ * range touches are put into the state, so they aren't split. For STATE_KSM this waits up to wait_ms for KSM to merge
+ * the pages. Returns the share of the pages found in the state afterwards, or -1 if it can't
+ * be determined (usually because we aren't running as root).
+ */
+double buffer_state_apply(void *p, size_t size, buffer_state state, unsigned wait_ms);
+
+/* the share of the pages of [p, p + size) in the given state, or -1 if unknown, as for buffer_state_apply */
+double buffer_state_ratio(void *p, size_t size, buffer_state state);
+
 #ifdef __cplusplus
 }
 #endif
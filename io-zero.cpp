@@ -0,0 +1,216 @@
+/*
+ * io-zero.cpp
+ */
+
+#include "io-zero.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include "fmt/format.h"
+#include "huge-alloc.h"
+#include "stats.hpp"
+
+const std::vector<std::string>& io_zero_methods() {
+    static const std::vector<std::string> methods{"zero-range", "punch-hole", "pwrite", "vmsplice", "splice", "copy-range"};
+    return methods;
+}
+
+static uint64_t mono_nanos() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* the name of the filesystem type of dir, e.g., tmpfs */
+static std::string fs_name(const std::string& dir) {
+    static const std::map<long, const char*> names{
+        {0x01021994, "tmpfs"}, {0xEF53, "ext4"}, {0x58465342, "xfs"}, {0x9123683E, "btrfs"},
+        {0x794c7630, "overlay"}, {0x6969, "nfs"}, {0x2fc12fc1, "zfs"}, {0xF2F52010, "f2fs"},
+    };
+    struct statfs sfs;
+    if (statfs(dir.c_str(), &sfs)) {
+        return "?";
+    }
+    auto it = names.find(sfs.f_type);
+    return it == names.end() ? fmt::format("{:#x}", (unsigned long)sfs.f_type) : it->second;
+}
+
+/* an unlinked file in dir, exiting on failure */
+static int temp_file(const std::string& dir) {
+    std::string path = dir + "/bench-io-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        fmt::print(stderr, "failed to create a file in {}: {}\n", dir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    unlink(path.c_str());
+    return fd;
+}
+
+/* write all of size bytes from buf to fd with pwrite, returning the number of calls or -1 on error */
+static long pwrite_all(int fd, const char* buf, size_t chunk, size_t size) {
+    long calls = 0;
+    for (size_t off = 0; off < size; calls++) {
+        ssize_t n = pwrite(fd, buf, std::min(chunk, size - off), off);
+        if (n <= 0) {
+            return -1;
+        }
+        off += n;
+    }
+    return calls;
+}
+
+/* move size bytes from the pipe, which is being filled by fill, into fd at offset 0 */
+template <typename FILL>
+static long splice_all(int fd, int pipe_rd, size_t chunk, size_t size, FILL fill) {
+    long calls = 0;
+    loff_t off = 0;
+    while ((size_t)off < size) {
+        ssize_t in = fill(std::min(chunk, size - off));
+        calls++;
+        if (in <= 0) {
+            return -1;
+        }
+        while (in > 0) {
+            ssize_t out = splice(pipe_rd, nullptr, fd, &off, in, SPLICE_F_MOVE);
+            calls++;
+            if (out <= 0) {
+                return -1;
+            }
+            in -= out;
+        }
+    }
+    return calls;
+}
+
+/**
+ * State shared by the trials of one directory: the file being zeroed, the zeroed and
+ * non-zero buffers, the pipe for the splice methods and the file of zeros for copy-range.
+ */
+struct io_zero_env {
+    int fd, zeros_fd = -1, dev_zero, pipe_rd, pipe_wr;
+    size_t chunk, zeros_size = 0;
+    char *zero_buf, *data_buf;
+
+    io_zero_env(const std::string& dir, size_t chunk, size_t max_size) : fd{temp_file(dir)}, chunk{chunk} {
+        zero_buf = static_cast<char*>(huge_alloc(chunk, false));
+        data_buf = static_cast<char*>(huge_alloc(chunk, false));
+        if (!zero_buf || !data_buf) {
+            exit(EXIT_FAILURE);
+        }
+        memset(zero_buf, 0, chunk);
+        memset(data_buf, 0x5a, chunk);
+        int fds[2];
+        if (pipe(fds) || (dev_zero = open("/dev/zero", O_RDONLY)) < 0) {
+            fmt::print(stderr, "failed to open a pipe or /dev/zero: {}\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        pipe_rd = fds[0];
+        pipe_wr = fds[1];
+        // a pipe as big as a chunk, where allowed, so each chunk moves in one pair of calls
+        fcntl(pipe_wr, F_SETPIPE_SZ, (int)std::min<size_t>(chunk, 1u << 20));
+        zeros_fd = temp_file(dir);
+        if (pwrite_all(zeros_fd, zero_buf, chunk, max_size) < 0) {
+            fmt::print(stderr, "failed to write the file of zeros: {}\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        zeros_size = max_size;
+    }
+
+    ~io_zero_env() {
+        for (int f : {fd, zeros_fd, dev_zero, pipe_rd, pipe_wr}) {
+            close(f);
+        }
+        huge_free(zero_buf);
+        huge_free(data_buf);
+    }
+
+    /* fill the file with size bytes of non-zero data, untimed */
+    void prepare(size_t size) {
+        if (ftruncate(fd, 0) || pwrite_all(fd, data_buf, chunk, size) < 0) {
+            fmt::print(stderr, "failed to prepare the file: {}\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* zero size bytes of the file with the given method, returning the system calls made, or -1 on failure */
+    long zero(const std::string& method, size_t size) {
+        if (method == "zero-range" || method == "punch-hole") {
+            int mode = method == "zero-range" ? FALLOC_FL_ZERO_RANGE : FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+            return fallocate(fd, mode, 0, size) ? -1 : 1;
+        } else if (method == "pwrite") {
+            return pwrite_all(fd, zero_buf, chunk, size);
+        } else if (method == "vmsplice") {
+            return splice_all(fd, pipe_rd, chunk, size, [&](size_t n) {
+                iovec iov{zero_buf, n};
+                return vmsplice(pipe_wr, &iov, 1, 0);
+            });
+        } else if (method == "splice") {
+            return splice_all(fd, pipe_rd, chunk, size, [&](size_t n) {
+                return splice(dev_zero, nullptr, pipe_wr, nullptr, n, SPLICE_F_MOVE);
+            });
+        } else {
+            long calls = 0;
+            loff_t in = 0, out = 0;
+            while ((size_t)out < size) {
+                ssize_t n = copy_file_range(zeros_fd, &in, fd, &out, size - out, 0);
+                calls++;
+                if (n <= 0) {
+                    return -1;
+                }
+            }
+            return calls;
+        }
+    }
+};
+
+table::Table run_io_zero(const io_zero_config& config, const std::vector<std::string>& methods) {
+    table::Table table;
+    table.setColColumnSeparator(" | ");
+    table.newRow().add("Dir").add("FS").add("Method").add("Size").add("GB/s").add("Syscalls/GB").add("Trials");
+    for (size_t c : {3, 4, 5, 6}) {
+        table.colInfo(c).justify = table::ColInfo::RIGHT;
+    }
+
+    size_t max_size = *std::max_element(config.sizes.begin(), config.sizes.end());
+    for (auto& dir : config.dirs) {
+        io_zero_env env{dir, config.chunk, max_size};
+        auto fs = fs_name(dir);
+        for (auto size : config.sizes) {
+            for (auto& method : methods) {
+                std::vector<double> nanos;
+                long calls = 0;
+                std::string error;
+                for (size_t t = 0; t < config.trials && error.empty(); t++) {
+                    env.prepare(size);
+                    auto start = mono_nanos();
+                    calls = env.zero(method, size);
+                    auto end = mono_nanos();
+                    if (calls < 0) {
+                        error = errno == EOPNOTSUPP ? "unsupported" : strerror(errno);
+                    }
+                    nanos.push_back(end - start);
+                }
+                auto& row = table.newRow().add(dir).add(fs).add(method).add(size);
+                if (!error.empty()) {
+                    row.add(error).add("-").add(0);
+                } else {
+                    row.addf("%.2f", size / Stats::median(nanos.begin(), nanos.end()));
+                    row.addf("%.1f", calls * 1e9 / size);
+                    row.add(nanos.size());
+                }
+            }
+        }
+    }
+    return table;
+}
@@ -0,0 +1,43 @@
+/*
+ * io-zero.hpp
+ *
+ * The --io-zero mode: zeroing a file through the I/O system calls, rather than
+ * through stores to a mapping.
+ */
+
+#ifndef IO_ZERO_HPP_
+#define IO_ZERO_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "table.hpp"
+
+struct io_zero_config {
+    std::vector<std::string> dirs;  // the directories to create the files in, e.g., a tmpfs and a local filesystem
+    std::vector<std::size_t> sizes; // the file sizes in bytes
+    std::size_t chunk;              // the bytes each pwrite, vmsplice or splice call moves
+    std::size_t trials;             // the trials for each method, directory and size
+};
+
+/**
+ * The zeroing methods, in the order they are run:
+ *   zero-range   fallocate(FALLOC_FL_ZERO_RANGE)
+ *   punch-hole   fallocate(FALLOC_FL_PUNCH_HOLE), which leaves the range sparse
+ *   pwrite       pwrite of chunk bytes at a time from a zeroed buffer
+ *   vmsplice     vmsplice of a zeroed buffer into a pipe, then splice into the file
+ *   splice       splice from /dev/zero into a pipe, then into the file
+ *   copy-range   copy_file_range from a file of zeros
+ */
+const std::vector<std::string>& io_zero_methods();
+
+/**
+ * Zero a file with each of the given methods, for each directory and size, and return a
+ * table with one row per method, directory and size giving the median bandwidth over the
+ * trials and the system calls per GB. Before each trial the file is filled with non-zero
+ * data, untimed, so every method has real work to do.
+ */
+table::Table run_io_zero(const io_zero_config& config, const std::vector<std::string>& methods);
+
+#endif /* IO_ZERO_HPP_ */
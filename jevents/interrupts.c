@@ -35,10 +35,18 @@ static __thread struct rdpmc_ctx int_ctx;
  * interrupts_init - Initialize interrupt counter per thread
  *
  * Must be called for each application thread.
+ * Returns 0 on success, or -1 if the counter couldn't be opened or can't
+ * be read with rdpmc (a zero index, in which case rdpmc_read would
+ * return just the offset).
  */
-void interrupts_init(void)
+int interrupts_init(void)
 {
 	int_ok = rdpmc_open(HW_INTERRUPTS, &int_ctx);
+	if (int_ok >= 0 && (!int_ctx.buf->cap_user_rdpmc || int_ctx.buf->index == 0)) {
+		rdpmc_close(&int_ctx);
+		int_ok = -1;
+	}
+	return int_ok;
 }
 
 /**
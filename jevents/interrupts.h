@@ -22,7 +22,7 @@
 extern "C" {
 #endif
 
-void interrupts_init(void);
+int interrupts_init(void);
 void interrupts_exit(void);
 unsigned long long get_interrupts(void);
 
@@ -19,6 +19,8 @@
 #include <err.h>
 #include <assert.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 
 #define PM_PFRAME_MASK         ((1ULL << 55) - 1)
@@ -253,6 +255,64 @@ page_info get_page_info(void *p) {
     return ret;
 }
 
+/* a page whose kpageflags are wanted: its pfn and its index in the infos array */
+typedef struct {
+    uint64_t pfn;
+    size_t idx;
+} pfn_ref;
+
+static int pfn_ref_cmp(const void *l, const void *r) {
+    uint64_t lp = ((const pfn_ref *)l)->pfn, rp = ((const pfn_ref *)r)->pfn;
+    return lp < rp ? -1 : lp > rp;
+}
+
+/* the most kpageflags entries read by a single pread */
+#define KPF_CHUNK 4096
+
+/* the work for one kpageflags reader: the refs in [first, last), sorted by pfn */
+typedef struct {
+    int fd;
+    const pfn_ref *refs;
+    size_t first, last;
+    page_info *infos;
+    bool ok;
+} kpf_work;
+
+/*
+ * Read the kpageflags for the refs in the work item, coalescing refs with the same or
+ * consecutive pfns into runs, so each run costs one pread rather than one per page.
+ */
+static void *read_kpageflags(void *arg) {
+    kpf_work *w = arg;
+    uint64_t bits[KPF_CHUNK];
+    w->ok = true;
+    for (size_t i = w->first; i < w->last; ) {
+        uint64_t base = w->refs[i].pfn;
+        size_t j = i + 1;
+        while (j < w->last && w->refs[j].pfn - base < KPF_CHUNK && w->refs[j].pfn - w->refs[j - 1].pfn <= 1) {
+            j++;
+        }
+        size_t count = w->refs[j - 1].pfn - base + 1;
+        ssize_t bytes = pread(w->fd, bits, count * sizeof(uint64_t), base * sizeof(uint64_t));
+        if (bytes != (ssize_t)(count * sizeof(uint64_t))) {
+            w->ok = false;
+            return NULL;
+        }
+        for (; i < j; i++) {
+            page_info *info = &w->infos[w->refs[i].idx];
+            info->kpageflags_ok = true;
+            info->kpageflags = bits[w->refs[i].pfn - base];
+        }
+    }
+    return NULL;
+}
+
+static unsigned kpageflags_threads = 1;
+
+void set_page_info_threads(unsigned threads) {
+    kpageflags_threads = threads ? threads : 1;
+}
+
 /**
  * Get information for each page in the range from start (inclusive) to end (exclusive).
  */
@@ -269,57 +329,64 @@ page_info_array get_info_for_range(void *start, void *end) {
 
     page_info *infos = malloc((page_count + 1) * sizeof(page_info));
 
-    // open the pagemap file
-    FILE *pagemap_file = fopen("/proc/self/pagemap", "rb");
-    if (!pagemap_file) err(EXIT_FAILURE, "failed to open pagemap");
-
-    // seek to the first page
-    if (fseek(pagemap_file, (uintptr_t)start_page / psize * sizeof(uint64_t), SEEK_SET)) err(EXIT_FAILURE, "pagemap seek failed");
+    // read the pagemap entries for the whole range at once
+    int pagemap_fd = open("/proc/self/pagemap", O_RDONLY);
+    if (pagemap_fd < 0) err(EXIT_FAILURE, "failed to open pagemap");
 
     size_t bitmap_bytes = page_count * sizeof(uint64_t);
     uint64_t* bitmap = malloc(bitmap_bytes);
     assert(bitmap);
-    size_t readc = fread(bitmap, bitmap_bytes, 1, pagemap_file);
-    if (readc != 1) err(EXIT_FAILURE, "unexpected fread(pagemap) return: %zu", readc);
-
-    fclose(pagemap_file);
+    ssize_t readc = pread(pagemap_fd, bitmap, bitmap_bytes, (uintptr_t)start_page / psize * sizeof(uint64_t));
+    if (readc != (ssize_t)bitmap_bytes) err(EXIT_FAILURE, "unexpected pread(pagemap) return: %zd", readc);
 
-    FILE *kpageflags_file = NULL;
-    enum { INIT, OPEN, FAILED  } file_state = INIT;
+    close(pagemap_fd);
 
+    pfn_ref *refs = malloc(page_count * sizeof(pfn_ref));
+    assert(refs);
+    size_t ref_count = 0;
     for (size_t page_idx = 0; page_idx < page_count; page_idx++) {
-        page_info info = extract_info(bitmap[page_idx]);
-
-        if (info.pfn) {
-            // we got a pfn, try to read /proc/kpageflags
-
-            // open file if not open
-            if (file_state == INIT) {
-                kpageflags_file = fopen("/proc/kpageflags", "rb");
-                if (!kpageflags_file) {
-                    warn("failed to open kpageflags");
-                    file_state = FAILED;
-                } else {
-                    file_state = OPEN;
-                }
-            }
+        infos[page_idx] = extract_info(bitmap[page_idx]);
+        if (infos[page_idx].pfn) {
+            refs[ref_count++] = (pfn_ref){ infos[page_idx].pfn, page_idx };
+        }
+    }
 
-            if (file_state == OPEN) {
-                uint64_t bits;
-                if (fseek(kpageflags_file, info.pfn * sizeof(bits), SEEK_SET)) err(EXIT_FAILURE, "kpageflags seek failed");
-                if ((readc = fread(&bits, sizeof(bits), 1, kpageflags_file)) != 1) err(EXIT_FAILURE, "unexpected fread(kpageflags) return: %zu", readc);
-                info.kpageflags_ok = true;
-                info.kpageflags = bits;
+    free(bitmap);
+
+    if (ref_count) {
+        // we got some pfns, try to read /proc/kpageflags, in pfn order so runs of pages can be read together
+        int kpageflags_fd = open("/proc/kpageflags", O_RDONLY);
+        if (kpageflags_fd < 0) {
+            warn("failed to open kpageflags");
+        } else {
+            qsort(refs, ref_count, sizeof(pfn_ref), pfn_ref_cmp);
+
+            // split the refs into one contiguous share per thread, with the calling thread taking the first
+            size_t threads = kpageflags_threads;
+            if (threads > ref_count / KPF_CHUNK + 1) {
+                threads = ref_count / KPF_CHUNK + 1;
+            }
+            kpf_work *work = malloc(threads * sizeof(kpf_work));
+            pthread_t *tids = malloc(threads * sizeof(pthread_t));
+            assert(work && tids);
+            for (size_t t = 0; t < threads; t++) {
+                work[t] = (kpf_work){ kpageflags_fd, refs, ref_count * t / threads, ref_count * (t + 1) / threads, infos, false };
+                if (t > 0 && pthread_create(&tids[t], NULL, read_kpageflags, &work[t])) err(EXIT_FAILURE, "pthread_create failed");
+            }
+            read_kpageflags(&work[0]);
+            for (size_t t = 0; t < threads; t++) {
+                if (t > 0) {
+                    pthread_join(tids[t], NULL);
+                }
+                if (!work[t].ok) err(EXIT_FAILURE, "unexpected pread(kpageflags) return");
             }
+            free(tids);
+            free(work);
+            close(kpageflags_fd);
         }
-
-        infos[page_idx] = info;
     }
 
-    if (kpageflags_file)
-        fclose(kpageflags_file);
-
-    free(bitmap);
+    free(refs);
 
     return (page_info_array){ page_count, infos };
 }
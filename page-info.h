@@ -140,6 +140,12 @@ page_info get_page_info(void *p);
  */
 page_info_array get_info_for_range(void *start, void *end);
 
+/**
+ * Set the number of threads get_info_for_range uses to read /proc/kpageflags (default 1).
+ * Extra threads only help for large ranges whose pages are scattered in physical memory.
+ */
+void set_page_info_threads(unsigned threads);
+
 /**
  * Free the memory associated with the given page_info_array. You shouldn't use it after this call.
  */
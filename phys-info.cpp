@@ -0,0 +1,83 @@
+/*
+ * phys-info.cpp
+ */
+
+#include "phys-info.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+#include "huge-alloc.h"
+#include "page-info.h"
+#include "util.hpp"
+
+static constexpr std::size_t PAGE = 4096, LINE = 64;
+
+bool channel_map::parse(const std::string& text, channel_map& map) {
+    map.masks.clear();
+    for (auto& term : split(text, ",")) {
+        uint64_t mask = 0;
+        for (auto& bit : split(term, "^")) {
+            char* end;
+            unsigned long b = strtoul(bit.c_str(), &end, 10);
+            if (bit.empty() || *end || b < 6 || b > 51) {
+                return false;
+            }
+            mask |= 1ull << b;
+        }
+        map.masks.push_back(mask);
+    }
+    return !map.masks.empty() && map.masks.size() <= 8;
+}
+
+double phys_layout::channel_skew() const {
+    uint64_t total = std::accumulate(channel_lines.begin(), channel_lines.end(), uint64_t{0});
+    if (total == 0) {
+        return 0;
+    }
+    return (double)*std::max_element(channel_lines.begin(), channel_lines.end()) * channel_lines.size() / total;
+}
+
+phys_layout get_phys_layout(void* p, std::size_t size, const channel_map& map) {
+    phys_layout layout;
+    char* start = (char*)p;
+    page_info_array infos = get_info_for_range(start, start + size);
+    if (infos.num_pages == 0 || !infos.info[0].pfn) {
+        free_info_array(infos);
+        return layout;
+    }
+    layout.ok = true;
+    layout.lo = UINT64_MAX;
+    layout.channel_lines.resize(map.empty() ? 0 : map.channels());
+
+    // the virtual address of the first page in infos, and the range of lines to count
+    uintptr_t vpage = (uintptr_t)start & ~(PAGE - 1), vstart = (uintptr_t)start, vend = vstart + size;
+    uint64_t prev_pfn = 0;
+    for (std::size_t i = 0; i < infos.num_pages; i++, vpage += PAGE) {
+        uint64_t pfn = infos.info[i].pfn;
+        if (!pfn) {
+            layout.ok = false; // not present, or not visible to us
+            continue;
+        }
+        layout.runs += pfn != prev_pfn + 1;
+        prev_pfn = pfn;
+        layout.lo = std::min(layout.lo, pfn * PAGE);
+        layout.hi = std::max(layout.hi, pfn * PAGE + PAGE - 1);
+        if (!map.empty()) {
+            uintptr_t lo = std::max(vpage, vstart) & ~(LINE - 1), hi = std::min(vpage + PAGE, vend);
+            for (uintptr_t v = lo; v < hi; v += LINE) {
+                layout.channel_lines[map.channel(pfn * PAGE + (v - vpage))]++;
+            }
+        }
+    }
+    free_info_array(infos);
+
+    std::vector<std::size_t> nodes(64);
+    if (page_node_counts(p, size, nodes.data(), nodes.size())) {
+        auto last = std::find_if(nodes.rbegin(), nodes.rend(), [](std::size_t n){ return n != 0; });
+        nodes.resize(nodes.rend() - last);
+        layout.node_pages = std::move(nodes);
+    }
+    return layout;
+}
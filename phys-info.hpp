@@ -0,0 +1,58 @@
+/*
+ * phys-info.hpp
+ *
+ * Where a buffer lives in physical memory: the physical address range backing it, how
+ * fragmented that range is and how it spreads over NUMA nodes and DRAM channels.
+ */
+
+#ifndef PHYS_INFO_HPP_
+#define PHYS_INFO_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A DRAM channel mapping in the usual XOR form: each bit of the channel index is the
+ * parity of the physical address bits in one mask, e.g., "6^13,7^14" describes 4
+ * channels, with index bit 0 = a6 ^ a13 and bit 1 = a7 ^ a14.
+ */
+struct channel_map {
+    std::vector<uint64_t> masks; // one mask per channel index bit, lowest bit first
+
+    /** parse a mapping like "6^13,7^14", returning false if it isn't valid */
+    static bool parse(const std::string& text, channel_map& map);
+
+    bool empty() const { return masks.empty(); }
+
+    std::size_t channels() const { return std::size_t(1) << masks.size(); }
+
+    unsigned channel(uint64_t paddr) const {
+        unsigned c = 0;
+        for (std::size_t b = 0; b < masks.size(); b++) {
+            c |= (unsigned)__builtin_parityll(paddr & masks[b]) << b;
+        }
+        return c;
+    }
+};
+
+struct phys_layout {
+    bool ok = false;       // false if the physical addresses couldn't be read, usually as non-root
+    uint64_t lo = 0;       // the lowest physical address backing the buffer
+    uint64_t hi = 0;       // and the highest
+    std::size_t runs = 0;  // the number of physically contiguous runs of pages
+    std::vector<std::size_t> node_pages; // the pages on each NUMA node, empty if unknown
+    std::vector<uint64_t> channel_lines; // the 64-byte lines on each channel, empty without a channel map
+
+    /** the share of the busiest channel over the mean share: 1 is a perfectly even spread */
+    double channel_skew() const;
+};
+
+/**
+ * Find the physical layout of [p, p + size), which should be faulted in. Lines are assigned
+ * to channels using map, if it isn't empty.
+ */
+phys_layout get_phys_layout(void* p, std::size_t size, const channel_map& map);
+
+#endif /* PHYS_INFO_HPP_ */
@@ -0,0 +1,145 @@
+/*
+ * precondition.cpp
+ */
+
+#include "precondition.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <sched.h>
+
+#include "fmt/format.h"
+#include "opt-control.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_FLUSH 1
+#else
+#define HAVE_FLUSH 0
+#endif
+
+static constexpr size_t LINE = 64;
+
+bool parse_precondition(const std::string& name, precondition& p) {
+    if      (name == "none")   p = precondition::NONE;
+    else if (name == "flush")  p = precondition::FLUSH;
+    else if (name == "clean")  p = precondition::CLEAN;
+    else if (name == "dirty")  p = precondition::DIRTY;
+    else if (name == "shared") p = precondition::SHARED;
+    else return false;
+    return true;
+}
+
+static void flush_lines(void* buf, size_t bytes) {
+#if HAVE_FLUSH
+    char* p = (char*)((uintptr_t)buf & ~(LINE - 1));
+    char* end = (char*)buf + bytes;
+    for (; p < end; p += LINE) {
+#ifdef __CLFLUSHOPT__
+        _mm_clflushopt(p);
+#else
+        _mm_clflush(p);
+#endif
+    }
+    _mm_mfence();
+#else
+    (void)buf;
+    (void)bytes;
+#endif
+}
+
+/* touch one word per line */
+static void read_lines(const void* buf, size_t bytes) {
+    const char* p = (const char*)buf;
+    uint64_t sum = 0;
+    for (size_t off = 0; off < bytes; off += LINE) {
+        sum += *(const volatile char*)(p + off);
+    }
+    opt_control::sink(sum);
+}
+
+/**
+ * The reader used by SHARED: a thread, ideally on another core, which reads a
+ * buffer on request so that each line ends up cached in both cores.
+ */
+class shared_reader {
+    std::mutex mutex;
+    std::condition_variable cv;
+    const void* buf = nullptr;
+    size_t bytes = 0;
+    bool pending = false;
+
+    void run(int cpu) {
+        if (cpu >= 0) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cpu, &cpuset);
+            if (sched_setaffinity(0, sizeof(cpuset), &cpuset) == -1) {
+                fmt::print(stderr, "could not pin the shared reader to CPU {}\n", cpu);
+                exit(EXIT_FAILURE);
+            }
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            cv.wait(lock, [this]{ return pending; });
+            read_lines(buf, bytes);
+            pending = false;
+            cv.notify_all();
+        }
+    }
+
+public:
+    explicit shared_reader(int cpu) {
+        std::thread{&shared_reader::run, this, cpu}.detach();
+    }
+
+    /* read the buffer from the reader thread, returning once it is done */
+    void read(const void* b, size_t n) {
+        std::unique_lock<std::mutex> lock(mutex);
+        buf = b;
+        bytes = n;
+        pending = true;
+        cv.notify_all();
+        cv.wait(lock, [this]{ return !pending; });
+    }
+};
+
+static shared_reader* reader;
+
+void precondition_init(precondition p, int cpu) {
+    if (!HAVE_FLUSH && (p == precondition::FLUSH || p == precondition::CLEAN)) {
+        fmt::print(stderr, "cache line flushing isn't supported on this platform\n");
+        exit(EXIT_FAILURE);
+    }
+    if (p == precondition::SHARED && !reader) {
+        reader = new shared_reader(cpu);
+    }
+}
+
+void precondition_apply(precondition p, void* buf, size_t bytes) {
+    switch (p) {
+    case precondition::NONE:
+        break;
+    case precondition::FLUSH:
+        flush_lines(buf, bytes);
+        break;
+    case precondition::CLEAN:
+        flush_lines(buf, bytes);
+        read_lines(buf, bytes);
+        break;
+    case precondition::DIRTY:
+        memset(buf, 0x5a, bytes);
+        break;
+    case precondition::SHARED:
+        // write back any dirty lines first, so the reads leave them shared rather than forwarded
+        flush_lines(buf, bytes);
+        read_lines(buf, bytes);
+        reader->read(buf, bytes);
+        break;
+    }
+}
@@ -0,0 +1,33 @@
+/*
+ * precondition.hpp
+ *
+ * Put a buffer into a given cache state before a trial, outside the timed region.
+ */
+
+#ifndef PRECONDITION_HPP_
+#define PRECONDITION_HPP_
+
+#include <cstddef>
+#include <string>
+
+enum class precondition {
+    NONE,   // leave the buffer in whatever state the previous trial left it
+    FLUSH,  // flush every line of the buffer out of the cache hierarchy
+    CLEAN,  // flush, then read every line: resident (as far as it fits) and clean
+    DIRTY,  // overwrite the buffer with non-zero data, leaving the lines dirty
+    SHARED  // read the buffer here and from another core, leaving the lines shared
+};
+
+/** parse the name of a precondition, returning false if the name is not valid */
+bool parse_precondition(const std::string& name, precondition& p);
+
+/**
+ * Set up anything needed for the given precondition: for SHARED this starts the
+ * thread which reads the buffer from another core, pinned to cpu if cpu >= 0.
+ */
+void precondition_init(precondition p, int cpu);
+
+/** apply the precondition to the bytes starting at buf */
+void precondition_apply(precondition p, void* buf, size_t bytes);
+
+#endif /* PRECONDITION_HPP_ */
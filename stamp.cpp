@@ -5,10 +5,20 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <errno.h>
 #include <map>
 #include <stdexcept>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <linux/perf_event.h>
+
+#include "jevents/interrupts.h"
+#include "jevents/jevents.h"
 
 #if USE_RDTSC
+#include "cpuid.hpp"
 #include "tsc-support.hpp"
 
 static inline uint64_t get_timestamp() {
@@ -80,11 +90,23 @@ uint64_t StampDelta::get_tsc() const {
 
 StampDelta::StampDelta(const StampConfig& config,
                uint64_t tsc_delta,
-               event_counts counters)
+               event_counts counters,
+               uint64_t interrupts,
+               uint64_t cswitches,
+               uint64_t migrations,
+               uint64_t faults,
+               uint64_t user,
+               uint64_t kernel)
         : empty(false),
           config{&config},
           tsc_delta{tsc_delta},
-          counters{std::move(counters)}
+          counters{std::move(counters)},
+          interrupts{interrupts},
+          cswitches{cswitches},
+          migrations{migrations},
+          faults{faults},
+          user{user},
+          kernel{kernel}
           {}
 
 StampDelta StampDelta::min(const StampDelta& l, const StampDelta& r) { return apply(l, r, min_functor{}); }
@@ -155,10 +177,101 @@ uint64_t MSRManager::get_value(uint32_t id, const Stamp& stamp) const {
 }
 
 
+static int open_event(uint32_t type, uint64_t config, bool exclude_user = false, bool exclude_kernel = false) {
+    struct perf_event_attr attr = {};
+    attr.type = type;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.exclude_user = exclude_user;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    return perf_event_open(&attr, 0, -1, -1, 0);
+}
+
+static int open_sw_event(uint64_t config) {
+    return open_event(PERF_TYPE_SOFTWARE, config);
+}
+
+static uint64_t read_event(int fd) {
+    uint64_t value = 0;
+    if (fd >= 0 && read(fd, &value, sizeof(value)) != sizeof(value)) {
+        value = 0;
+    }
+    return value;
+}
+
+/* the raw event jevents counts interrupts with (HW_INTERRUPTS.RECEIVED) is Intel specific */
+static bool interrupt_event_supported() {
+#if USE_RDTSC
+    return get_vendor_string() == "GenuineIntel";
+#else
+    return false;
+#endif
+}
+
+void InterruptManager::prepare() {
+    if (!enabled) {
+        return;
+    }
+    // the interrupts counter is optional: context switches and migrations work on any CPU
+    if (!interrupt_event_supported()) {
+        fprintf(stderr, "WARNING: interrupt counting needs an Intel CPU, detecting only context switches and migrations\n");
+    } else if (interrupts_init() < 0) {
+        fprintf(stderr, "WARNING: failed to open a readable interrupts counter, detecting only context switches and migrations\n");
+    } else {
+        hw_interrupts = true;
+    }
+    cs_fd  = open_sw_event(PERF_COUNT_SW_CONTEXT_SWITCHES);
+    mig_fd = open_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS);
+    if (cs_fd < 0 || mig_fd < 0) {
+        fprintf(stderr, "WARNING: failed to open the context-switches or cpu-migrations event: %s\n", strerror(errno));
+    }
+    if (!hw_interrupts && cs_fd < 0 && mig_fd < 0) {
+        fprintf(stderr, "WARNING: nothing to detect interruptions with, interrupt detection is off\n");
+        enabled = false;
+    }
+}
+
+void InterruptManager::do_stamp_slowpath(Stamp &stamp) const {
+    stamp.interrupts = hw_interrupts ? get_interrupts() : 0;
+    stamp.cswitches  = read_event(cs_fd);
+    stamp.migrations = read_event(mig_fd);
+}
+
+void FaultManager::prepare() {
+    if (!enabled) {
+        return;
+    }
+    fault_fd  = open_sw_event(PERF_COUNT_SW_PAGE_FAULTS);
+    if (fault_fd < 0) {
+        fprintf(stderr, "WARNING: failed to open the page-faults event: %s\n", strerror(errno));
+    }
+    user_fd   = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, false, true);
+    kernel_fd = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true, false);
+    if (!has_cycles()) {
+        vprint("user and kernel cycles unavailable (%s), using rusage\n", strerror(errno));
+    }
+}
+
+void FaultManager::do_stamp_slowpath(Stamp &stamp) const {
+    stamp.faults = read_event(fault_fd);
+    if (has_cycles()) {
+        stamp.user   = read_event(user_fd);
+        stamp.kernel = read_event(kernel_fd);
+    } else {
+        struct rusage ru;
+        getrusage(RUSAGE_THREAD, &ru);
+        stamp.user   = ru.ru_utime.tv_sec * 1000000000ull + ru.ru_utime.tv_usec * 1000ull;
+        stamp.kernel = ru.ru_stime.tv_sec * 1000000000ull + ru.ru_stime.tv_usec * 1000ull;
+    }
+}
+
 StampConfig::StampConfig() {}
 
 void StampConfig::prepare() {
     em.prepare();
+    im.prepare();
+    fm.prepare();
 }
 
 Stamp StampConfig::stamp() const {
@@ -168,12 +281,27 @@ Stamp StampConfig::stamp() const {
 
     Stamp s(tsc, counters, tsc_before, 0);
     mm.do_stamp(s);
+    im.do_stamp(s);
+    fm.do_stamp(s);
 
     return s;
 }
 
 StampDelta StampConfig::delta(const Stamp& before, const Stamp& after) const {
-    return StampDelta(*this, after.tsc - before.tsc, calc_delta(before.counters, after.counters));
+    return StampDelta::apply(raw_delta(before, after), overhead,
+            [](uint64_t l, uint64_t r) { return l > r ? l - r : 0; });
+}
+
+StampDelta StampConfig::delta(const Stamp& before, const Stamp& after, size_t calls) const {
+    double scale = (double)calls / call_overhead_calls;
+    return StampDelta::apply(delta(before, after), call_overhead,
+            [=](uint64_t l, uint64_t r) { uint64_t c = r * scale; return l > c ? l - c : 0; });
+}
+
+StampDelta StampConfig::raw_delta(const Stamp& before, const Stamp& after) const {
+    return StampDelta(*this, after.tsc - before.tsc, calc_delta(before.counters, after.counters),
+            after.interrupts - before.interrupts, after.cswitches - before.cswitches, after.migrations - before.migrations,
+            after.faults - before.faults, after.user - before.user, after.kernel - before.kernel);
 }
 
 uint64_t StampDelta::get_counter(const PerfEvent& event) const {
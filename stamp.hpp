@@ -6,6 +6,7 @@
 #include <stddef.h>
 
 #include <map>
+#include <stdexcept>
 
 #include "perf-timer.hpp"
 #include "hedley.h"
@@ -36,6 +37,10 @@ public:
     size_t retries;
     uint64_t msr_values[MAX_MSR];
     size_t msrs_read;
+    // only read if the InterruptManager is enabled
+    uint64_t interrupts = 0, cswitches = 0, migrations = 0;
+    // only read if the FaultManager is enabled
+    uint64_t faults = 0, user = 0, kernel = 0;
 };
 
 /**
@@ -53,10 +58,18 @@ class StampDelta {
     // not cycles: has arbitrary units
     uint64_t tsc_delta;
     event_counts counters;
+    uint64_t interrupts, cswitches, migrations;
+    uint64_t faults, user, kernel;
 
     StampDelta(const StampConfig& config,
                uint64_t tsc_delta,
-               event_counts counters);
+               event_counts counters,
+               uint64_t interrupts = 0,
+               uint64_t cswitches = 0,
+               uint64_t migrations = 0,
+               uint64_t faults = 0,
+               uint64_t user = 0,
+               uint64_t kernel = 0);
 
 public:
     /**
@@ -64,7 +77,10 @@ public:
      * never be returned from functions like min(), unless both arguments
      * are empty. Handy for accumulation patterns.
      */
-    StampDelta() : empty(true), config{nullptr}, tsc_delta{}, counters{} {}
+    StampDelta() : empty(true), config{nullptr}, tsc_delta{}, counters{}, interrupts{}, cswitches{}, migrations{},
+            faults{}, user{}, kernel{} {}
+
+    bool is_empty() const { return empty; }
 
     double get_nanos() const;
 
@@ -76,6 +92,23 @@ public:
 
     uint64_t get_counter(const PerfEvent& event) const;
 
+    /** hardware interrupts, context switches and CPU migrations, if the InterruptManager is enabled */
+    uint64_t get_interrupts() const { return interrupts; }
+    uint64_t get_cswitches() const { return cswitches; }
+    uint64_t get_migrations() const { return migrations; }
+
+    /**
+     * Page faults, and the time spent in user and kernel mode, if the FaultManager is enabled: in
+     * cycles if FaultManager::has_cycles(), otherwise in nanos (which are tick based, so only the
+     * ratio of the two is meaningful for short intervals).
+     */
+    uint64_t get_faults() const { return faults; }
+    uint64_t get_user() const { return user; }
+    uint64_t get_kernel() const { return kernel; }
+
+    /** true if anything that disturbs a measurement happened in the interval */
+    bool contaminated() const { return interrupts || cswitches || migrations; }
+
     /**
      * Return a new StampDelta with every contained element having the minimum
      * value between the left and right arguments.
@@ -92,7 +125,9 @@ public:
             return l;
         assert(l.config == r.config);
         event_counts new_counts            = event_counts::apply(l.counters, r.counters, f);
-        return StampDelta{*l.config, {f(l.tsc_delta, r.tsc_delta)}, new_counts};
+        return StampDelta{*l.config, {f(l.tsc_delta, r.tsc_delta)}, new_counts,
+                f(l.interrupts, r.interrupts), f(l.cswitches, r.cswitches), f(l.migrations, r.migrations),
+                f(l.faults, r.faults), f(l.user, r.user), f(l.kernel, r.kernel)};
     }
 
     static StampDelta min(const StampDelta& l, const StampDelta& r);
@@ -197,6 +232,70 @@ public:
     uint64_t get_value(uint32_t id, const Stamp& stamp) const;
 };
 
+/**
+ * Counts the things that contaminate a measurement: hardware interrupts, using the
+ * jevents interrupts counter, and context switches and CPU migrations, using software
+ * perf events. Nothing is read unless enable() is called before prepare().
+ */
+class InterruptManager {
+    bool enabled = false;
+    bool hw_interrupts = false; // true if the rdpmc interrupts counter is usable
+    int cs_fd = -1, mig_fd = -1;
+
+public:
+    void enable() { enabled = true; }
+
+    bool is_enabled() const { return enabled; }
+
+    /*
+     * Open the counters, printing a warning for any which are unavailable. If none of them
+     * are available, this disables the manager, so is_enabled() returns false.
+     */
+    void prepare();
+
+    HEDLEY_ALWAYS_INLINE
+    void do_stamp(Stamp &stamp) const {
+        if (HEDLEY_UNLIKELY(enabled)) {
+            do_stamp_slowpath(stamp);
+        }
+    }
+
+    HEDLEY_NEVER_INLINE
+    void do_stamp_slowpath(Stamp &stamp) const;
+};
+
+/**
+ * Counts page faults, using a software perf event, and splits the time into user and
+ * kernel mode: with the user-only and kernel-only cycles events where the PMU allows,
+ * otherwise with the thread's rusage. Nothing is read unless enable() is called before
+ * prepare().
+ */
+class FaultManager {
+    bool enabled = false;
+    int fault_fd = -1, user_fd = -1, kernel_fd = -1;
+
+public:
+    void enable() { enabled = true; }
+
+    bool is_enabled() const { return enabled; }
+
+    /** true if user and kernel time are counted in cycles, false if they come from rusage */
+    bool has_cycles() const { return user_fd >= 0 && kernel_fd >= 0; }
+
+    /* open the counters, printing a warning for any which are unavailable */
+    void prepare();
+
+    HEDLEY_ALWAYS_INLINE
+    void do_stamp(Stamp &stamp) const {
+        if (HEDLEY_UNLIKELY(enabled)) {
+            do_stamp_slowpath(stamp);
+        }
+    }
+
+    HEDLEY_NEVER_INLINE
+    void do_stamp_slowpath(Stamp &stamp) const;
+};
+
 /**
  * A class that holds configuration for creating stamps.
  *
@@ -204,9 +303,15 @@ public:
  * of objects.
  */
 class StampConfig {
+    StampDelta overhead;
+    StampDelta call_overhead;
+    size_t call_overhead_calls = 1;
+
 public:
     EventManager em;
     MSRManager mm;
+    InterruptManager im;
+    FaultManager fm;
 
     StampConfig();
 
@@ -222,9 +327,36 @@ public:
 
     /**
      * Create a StampDelta from the given before/after stamps
-     * which should have been created by this StampConfig.
+     * which should have been created by this StampConfig, less
+     * the overhead set by set_overhead (saturating at zero).
      */
     StampDelta delta(const Stamp& before, const Stamp& after) const;
+
+    /**
+     * Like delta(), but also less the overhead of the given number of calls of the
+     * test function, pro rata from the overhead set by set_call_overhead.
+     */
+    StampDelta delta(const Stamp& before, const Stamp& after, size_t calls) const;
+
+    /** like delta(), but without subtracting the overhead */
+    StampDelta raw_delta(const Stamp& before, const Stamp& after) const;
+
+    /**
+     * Set the fixed cost of taking a pair of stamps around nothing, which
+     * delta() will subtract. An empty delta (the default) subtracts nothing.
+     */
+    void set_overhead(const StampDelta& o) { overhead = o; }
+
+    const StampDelta& get_overhead() const { return overhead; }
+
+    /**
+     * Set the cost of the given number of calls of an empty test function, less the
+     * stamp overhead, which delta(before, after, calls) subtracts.
+     */
+    void set_call_overhead(const StampDelta& o, size_t calls) {
+        call_overhead = o;
+        call_overhead_calls = calls;
+    }
 };
 
 
@@ -7,6 +7,7 @@
 #ifndef STATS_HPP_
 #define STATS_HPP_
 
+#include <cmath>
 #include <string>
 #include <iomanip>
 #include <sstream>
@@ -14,6 +15,9 @@
 #include <limits>
 #include <iterator>
 #include <functional>
+#include <random>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace Stats {
@@ -70,9 +74,14 @@ typename std::iterator_traits<iter_type>::value_type median(iter_type first, ite
 	}
 	using T = typename std::iterator_traits<iter_type>::value_type;
 	std::vector<T> copy(first, last);
-	std::sort(copy.begin(), copy.end(), comp);
 	size_t sz = copy.size(), half_sz = sz / 2;
-	return sz % 2 ? copy[half_sz] : (copy[half_sz - 1] + copy[half_sz]) / 2;
+	std::nth_element(copy.begin(), copy.begin() + half_sz, copy.end(), comp);
+	if (sz % 2) {
+		return copy[half_sz];
+	}
+	// after nth_element the lower middle element is the largest of the elements before half_sz
+	T lower = *std::max_element(copy.begin(), copy.begin() + half_sz, comp);
+	return (lower + copy[half_sz]) / 2;
 }
 
 /**
@@ -88,9 +97,9 @@ typename std::iterator_traits<iter_type>::value_type medianf(iter_type first, it
     }
     using T = typename std::iterator_traits<iter_type>::value_type;
     std::vector<T> copy(first, last);
-    std::sort(copy.begin(), copy.end(), comp);
-    assert(!copy.empty());
-    return copy[(copy.size() - 1) / 2];
+    auto mid = copy.begin() + (copy.size() - 1) / 2;
+    std::nth_element(copy.begin(), mid, copy.end(), comp);
+    return *mid;
 }
 
 template <typename iter_type>
@@ -100,6 +109,140 @@ typename std::iterator_traits<iter_type>::value_type median(iter_type first, ite
 }
 
 
+/**
+ * A distribution-free confidence interval for the median, based on order statistics,
+ * at roughly 95% confidence. Returns the relative half-width of the interval, i.e., the
+ * half-width divided by the median, so 0.01 means the median is known to about +/- 1%.
+ *
+ * With fewer than 6 samples the interval is simply the full range of the samples.
+ */
+template <typename iter_type>
+double median_ci(iter_type first, iter_type last) {
+	if (first == last) {
+		throw std::logic_error("can't get median CI of empty range");
+	}
+	std::vector<double> sorted(first, last);
+	std::sort(sorted.begin(), sorted.end());
+	double n = sorted.size(), z = 1.96 * std::sqrt(n);
+	// 1-based ranks of the order statistics bounding the interval
+	double j = std::floor((n - z) / 2), k = std::ceil(1 + (n + z) / 2);
+	size_t lo = j < 1 ? 0 : (size_t)j - 1, hi = k > n ? sorted.size() - 1 : (size_t)k - 1;
+	size_t half = sorted.size() / 2;
+	double med = sorted.size() % 2 ? sorted[half] : (sorted[half - 1] + sorted[half]) / 2;
+	double width = (sorted[hi] - sorted[lo]) / 2;
+	if (med == 0) {
+		return width == 0 ? 0 : std::numeric_limits<double>::infinity();
+	}
+	return width / std::fabs(med);
+}
+
+/**
+ * Summary statistics over a sample of values, computed from a single sorted copy
+ * of the input.
+ *
+ * If reject_k is positive, samples further than reject_k scaled MADs from the median
+ * are rejected as outliers before anything else is calculated. The scaled MAD is the
+ * MAD times 1.4826, which estimates the standard deviation for normal data.
+ */
+class Summary {
+	std::vector<double> sorted_;
+	double mean_ = 0, stddev_ = 0, mad_ = 0;
+	size_t rejected_ = 0;
+
+	/* the p-th percentile (0 <= p <= 100) of sorted, interpolating between closest ranks */
+	static double percentile(const std::vector<double>& sorted, double p) {
+		double rank = p / 100 * (sorted.size() - 1);
+		size_t lo = (size_t)rank, hi = std::min(lo + 1, sorted.size() - 1);
+		return sorted[lo] + (rank - lo) * (sorted[hi] - sorted[lo]);
+	}
+
+	/* the MAD of the values in sorted, whose median is med */
+	static double mad(const std::vector<double>& sorted, double med) {
+		std::vector<double> devs;
+		devs.reserve(sorted.size());
+		for (double v : sorted) {
+			devs.push_back(std::fabs(v - med));
+		}
+		return Stats::median(devs.begin(), devs.end());
+	}
+
+public:
+	template <typename iter_type>
+	Summary(iter_type first, iter_type last, double reject_k = 0) : sorted_(first, last) {
+		if (sorted_.empty()) {
+			throw std::logic_error("can't summarize an empty range");
+		}
+		std::sort(sorted_.begin(), sorted_.end());
+		mad_ = mad(sorted_, getMedian());
+
+		if (reject_k > 0) {
+			// the kept samples are a contiguous range of the sorted samples
+			double med = getMedian(), limit = reject_k * 1.4826 * mad_;
+			auto lo = std::lower_bound(sorted_.begin(), sorted_.end(), med - limit);
+			auto hi = std::upper_bound(lo, sorted_.end(), med + limit);
+			rejected_ = sorted_.size() - (hi - lo);
+			sorted_ = std::vector<double>(lo, hi);
+			mad_ = mad(sorted_, getMedian());
+		}
+
+		double total = 0;
+		for (double v : sorted_) {
+			total += v;
+		}
+		mean_ = total / sorted_.size();
+		double sumsq = 0;
+		for (double v : sorted_) {
+			sumsq += (v - mean_) * (v - mean_);
+		}
+		stddev_ = sorted_.size() > 1 ? std::sqrt(sumsq / (sorted_.size() - 1)) : 0;
+	}
+
+	/* number of samples remaining after outlier rejection */
+	size_t getCount() const { return sorted_.size(); }
+
+	/* number of samples rejected as outliers */
+	size_t getRejected() const { return rejected_; }
+
+	double getMin() const { return sorted_.front(); }
+	double getMax() const { return sorted_.back(); }
+	double getMean() const { return mean_; }
+
+	/* the sample standard deviation */
+	double getStddev() const { return stddev_; }
+
+	/* the median absolute deviation (unscaled) */
+	double getMAD() const { return mad_; }
+
+	double getMedian() const { return percentile(50); }
+
+	/* the p-th percentile, for p in [0, 100] */
+	double percentile(double p) const {
+		return percentile(sorted_, std::min(std::max(p, 0.), 100.));
+	}
+
+	/**
+	 * A percentile bootstrap confidence interval for the median: the median of resamples
+	 * random resamples (with replacement) is calculated and the interval is taken from the
+	 * distribution of those medians. The generator is seeded with a constant so the result
+	 * for a given sample is reproducible.
+	 */
+	std::pair<double, double> bootstrapCI(double confidence = 0.95, size_t resamples = 1000) const {
+		std::mt19937_64 rng{0x5eed};
+		std::uniform_int_distribution<size_t> pick{0, sorted_.size() - 1};
+		std::vector<double> medians, resample(sorted_.size());
+		medians.reserve(resamples);
+		for (size_t r = 0; r < resamples; r++) {
+			for (auto& v : resample) {
+				v = sorted_[pick(rng)];
+			}
+			medians.push_back(Stats::median(resample.begin(), resample.end()));
+		}
+		std::sort(medians.begin(), medians.end());
+		double tail = (1 - confidence) / 2 * 100;
+		return {percentile(medians, tail), percentile(medians, 100 - tail)};
+	}
+};
+
 template <typename iter_type>
 DescriptiveStats get_stats(iter_type first, iter_type last) {
 	using dlimits = std::numeric_limits<double>;
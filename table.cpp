@@ -60,7 +60,10 @@ Row& Table::newRow() {
 
 /** return the current representation of the table as a string */
 std::string Table::str() const {
+    return str(colSizes());
+}
 
+std::vector<size_t> Table::colSizes() const {
     // calculate max row sizes
     std::vector<size_t> max_sizes;
     for (const auto& r : rows_) {
@@ -75,10 +78,13 @@ std::string Table::str() const {
             }
         }
     }
+    return max_sizes;
+}
 
+std::string Table::str(const std::vector<size_t>& sizes, size_t first_row) const {
     std::stringstream ss;
-    for (const auto& r : rows_) {
-        r.str(ss, max_sizes);
+    for (size_t r = first_row; r < rows_.size(); r++) {
+        rows_[r].str(ss, sizes);
         ss << "\n";
     }
 
@@ -98,10 +104,10 @@ void Row::str(std::ostream& os, const std::vector<size_t> sizes) const
     }
 }
 
-std::string Table::csv_str() const {
+std::string Table::csv_str(size_t first_row) const {
     std::string out;
-    for (const auto& r : rows_) {
-        r.csv_str(out);
+    for (size_t r = first_row; r < rows_.size(); r++) {
+        rows_[r].csv_str(out);
         out += '\n';
     }
     return out;
@@ -131,8 +131,18 @@ public:
     /** return a representation of the table as a human readable, column-aligned string */
     std::string str() const;
 
-    /** return the table as csv without padding */
-    std::string csv_str() const;
+    /**
+     * Like str(), but with the given column widths, which must be at least those returned by
+     * colSizes(), and starting at the given row: lets rows be written a few at a time
+     * with the columns still lined up.
+     */
+    std::string str(const std::vector<size_t>& sizes, size_t first_row = 0) const;
+
+    /** the width of each column: the width of its widest cell */
+    std::vector<size_t> colSizes() const;
+
+    /** return the table as csv without padding, starting at the given row */
+    std::string csv_str(size_t first_row = 0) const;
 
     void setColColumnSeparator(std::string s) {
         sep = s;
@@ -6,7 +6,11 @@
  */
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <x86intrin.h>
 
+#include "jevents/rdpmc.h"
 #include "tsc-support.hpp"
 
 
@@ -31,11 +35,90 @@ struct RdtscClock {
         return to_nanos(n);
     }
 
+    /* TSC ticks, i.e., reference cycles */
+    static double to_cycles(delta_t diff) {
+        return diff;
+    }
+
     static uint64_t tsc_freq() {
         static uint64_t freq = get_tsc_freq(false);
         return freq;
     }
 
+    static void init() {}
+};
+
+/**
+ * Like RdtscClock, but using rdtscp, which waits for all earlier instructions
+ * to execute before reading the TSC.
+ */
+struct RdtscpClock : RdtscClock {
+    static now_t now() {
+        unsigned aux;
+        now_t ret = __rdtscp(&aux);
+         __builtin_ia32_lfence();
+        return ret;
+    }
+};
+
+/**
+ * A clock that counts actual core cycles, read with rdpmc from a perf_events
+ * cycles counter, so results don't depend on the current frequency. The
+ * conversion to nanos assumes the core runs at the TSC frequency, so it
+ * is only approximate.
+ */
+struct RdpmcClock : RdtscClock {
+    static now_t now() {
+         __builtin_ia32_lfence();
+        now_t ret = rdpmc_read(&ctx());
+         __builtin_ia32_lfence();
+        return ret;
+    }
+
+    /* actual core cycles */
+    static double to_cycles(delta_t diff) {
+        return diff;
+    }
+
+    static void init() {
+        ctx();
+    }
+
+private:
+    static rdpmc_ctx& ctx() {
+        static rdpmc_ctx ctx = open();
+        return ctx;
+    }
+
+    /*
+     * The counter is pinned, so the --perf-cols events can't multiplex it out: if it can't
+     * have a counter of its own it fails here rather than reading as a constant. rdpmc_read
+     * also returns just the offset if user space rdpmc is disabled, so both are checked.
+     */
+    static rdpmc_ctx open() {
+        perf_event_attr attr = {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = PERF_ATTR_SIZE_VER0;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.sample_type = PERF_SAMPLE_READ;
+        attr.exclude_kernel = 1;
+        attr.pinned = 1;
+        rdpmc_ctx ctx;
+        if (rdpmc_open_attr(&attr, &ctx, nullptr)) {
+            fprintf(stderr, "failed to open the rdpmc cycles counter: no PMU access, or perf_event_paranoid is too high\n");
+            exit(EXIT_FAILURE);
+        }
+        if (!ctx.buf->cap_user_rdpmc) {
+            fprintf(stderr, "the rdpmc cycles counter can't be read from user space (is /sys/devices/cpu/rdpmc 0?)\n");
+            exit(EXIT_FAILURE);
+        }
+        if (ctx.buf->index == 0) {
+            fprintf(stderr, "the rdpmc cycles counter isn't on a hardware counter, probably because "
+                    "the --perf-cols events or another user took them all\n");
+            exit(EXIT_FAILURE);
+        }
+        return ctx;
+    }
 };
 
 #endif
\ No newline at end of file